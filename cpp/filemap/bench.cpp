@@ -0,0 +1,301 @@
+// 比较几种读文件方式的吞吐量：mmap（FileMapReader，有无 madvise）、pread（不同缓冲区大小）、
+// std::ifstream 以及 O_DIRECT。分别测试顺序扫描和随机 4K 读取，冷缓存和热缓存两种情况。
+// 随机读取每次读一页，所以 pread 和 ifstream 只用 4K 缓冲区测一次；O_DIRECT 绕过页缓存，只测冷缓存。
+//
+// 编译: g++ -std=c++17 -O2 bench.cpp -o bench
+// 运行: ./bench [file | size_mb]
+//   参数不是文件名而是一个整数时（或者不给参数），会在当前目录生成一个 size_mb（默认 256）MB 的临时文件，
+//   结束后删除。测冷缓存时文件最好比内存大，或者至少不要太小。
+//   冷缓存通过 posix_fadvise(POSIX_FADV_DONTNEED) 丢弃页缓存实现，不需要 root，
+//   但对某些并行文件系统只是尽力而为，文件不要在别的进程里被打开。
+#include "filemap.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <vector>
+
+#ifndef __linux__
+#error "bench.cpp only supports linux"
+#endif
+
+using namespace util;
+
+namespace
+{
+
+constexpr std::size_t page = 4096;
+constexpr std::size_t random_reads = 20000;
+
+// 防止读出来的数据被优化掉
+volatile uint64_t g_sink;
+
+uint64_t consume(const void *p, std::size_t n)
+{
+    auto b = static_cast<const unsigned char *>(p);
+    uint64_t s = 0;
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        uint64_t v;
+        std::memcpy(&v, b + i, 8);
+        s += v;
+    }
+    for (; i < n; ++i)
+        s += b[i];
+    return s;
+}
+
+void drop_cache(const std::string &filename)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1)
+        return;
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+void warm_cache(const std::string &filename)
+{
+    FileMapReader reader(filename);
+    if (reader.good())
+        g_sink = consume(reader.data(), reader.file_size());
+}
+
+std::vector<std::size_t> random_offsets(std::size_t file_size)
+{
+    std::mt19937_64 rng(382);
+    std::uniform_int_distribution<std::size_t> dist(0, file_size / page - 1);
+    std::vector<std::size_t> offsets(random_reads);
+    for (auto &off : offsets)
+        off = dist(rng) * page;
+    return offsets;
+}
+
+// 返回处理的字节数，负数表示该方式不可用
+using Method = std::function<long long(const std::string &, std::size_t, const std::vector<std::size_t> *)>;
+
+long long mmap_read(const std::string &filename, int advice, const std::vector<std::size_t> *offsets)
+{
+    FileMapReader reader(filename);
+    if (!reader.good())
+        return -1;
+    if (advice != -1)
+        madvise(const_cast<void *>(reader.data()), reader.file_size(), advice);
+    auto p = static_cast<const char *>(reader.data());
+    if (offsets == nullptr)
+    {
+        g_sink = consume(p, reader.file_size());
+        return reader.file_size();
+    }
+    uint64_t s = 0;
+    for (auto off : *offsets)
+        s += consume(p + off, page);
+    g_sink = s;
+    return offsets->size() * page;
+}
+
+long long pread_read(const std::string &filename, std::size_t bufsize, int flags,
+                     const std::vector<std::size_t> *offsets)
+{
+    int fd = open(filename.c_str(), O_RDONLY | flags);
+    if (fd == -1)
+        return -1;
+    void *buf = nullptr;
+    if (posix_memalign(&buf, page, bufsize) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    long long total = 0;
+    uint64_t s = 0;
+    if (offsets == nullptr)
+    {
+        ssize_t n;
+        // O_DIRECT 要求偏移对齐，读到不满一个缓冲区就说明到了文件末尾
+        while ((n = pread(fd, buf, bufsize, total)) > 0)
+        {
+            s += consume(buf, n);
+            total += n;
+            if (static_cast<std::size_t>(n) < bufsize)
+                break;
+        }
+        if (n < 0)
+            total = -1;
+    }
+    else
+    {
+        for (auto off : *offsets)
+        {
+            ssize_t n = pread(fd, buf, bufsize, off);
+            if (n < 0)
+            {
+                total = -1;
+                break;
+            }
+            s += consume(buf, n);
+            total += n;
+        }
+    }
+    g_sink = s;
+    free(buf);
+    close(fd);
+    return total;
+}
+
+long long ifstream_read(const std::string &filename, std::size_t bufsize, const std::vector<std::size_t> *offsets)
+{
+    std::ifstream ifs(filename, std::ios::binary);
+    if (!ifs)
+        return -1;
+    std::vector<char> buf(bufsize);
+    long long total = 0;
+    uint64_t s = 0;
+    if (offsets == nullptr)
+    {
+        while (ifs.read(buf.data(), bufsize) || ifs.gcount() > 0)
+        {
+            s += consume(buf.data(), ifs.gcount());
+            total += ifs.gcount();
+        }
+    }
+    else
+    {
+        for (auto off : *offsets)
+        {
+            ifs.seekg(off);
+            ifs.read(buf.data(), bufsize);
+            s += consume(buf.data(), ifs.gcount());
+            total += ifs.gcount();
+        }
+    }
+    g_sink = s;
+    return total;
+}
+
+void run(const char *name, const std::string &filename, std::size_t file_size, bool cold,
+         const std::vector<std::size_t> *offsets, const Method &method)
+{
+    if (cold)
+        drop_cache(filename);
+    else
+        warm_cache(filename);
+    auto start = std::chrono::steady_clock::now();
+    long long bytes = method(filename, file_size, offsets);
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::printf("%-28s %-10s %-5s ", name, offsets ? "random4k" : "seq", cold ? "cold" : "warm");
+    if (bytes < 0)
+    {
+        std::printf("%12s\n", "unsupported");
+        return;
+    }
+    std::printf("%10.1f MB/s", bytes / sec / (1 << 20));
+    if (offsets)
+        std::printf("%12.0f IOPS", offsets->size() / sec);
+    std::printf("\n");
+}
+
+} // namespace
+
+int main(int argc, char const *argv[])
+{
+    std::string filename;
+    bool temporary = argc < 2 || std::strspn(argv[1], "0123456789") == std::strlen(argv[1]);
+    if (temporary)
+    {
+        std::size_t size_mb = argc < 2 ? 256 : std::strtoull(argv[1], nullptr, 10);
+        filename = "filemap_bench.tmp";
+        std::ofstream ofs(filename, std::ios::binary);
+        std::vector<char> buf(1 << 20);
+        std::mt19937 rng(0);
+        for (auto &c : buf)
+            c = static_cast<char>(rng());
+        for (std::size_t i = 0; i < size_mb; ++i)
+            ofs.write(buf.data(), buf.size());
+    }
+    else
+    {
+        filename = argv[1];
+    }
+    std::size_t file_size;
+    {
+        FileMapReader reader(filename);
+        if (!reader.good())
+        {
+            std::fprintf(stderr, "%s\n", reader.error_msg().c_str());
+            return 1;
+        }
+        file_size = reader.file_size();
+    }
+    if (file_size < page)
+    {
+        std::fprintf(stderr, "file is too small for benchmark\n");
+        return 1;
+    }
+    std::printf("file: %s, size: %.1f MB\n", filename.c_str(), file_size / double(1 << 20));
+
+    struct Entry
+    {
+        const char *name;
+        Method method;
+        bool direct; // O_DIRECT 不经过页缓存，没有热缓存的情况
+    };
+    // 顺序扫描和随机读取分别测试的方式，随机读取的缓冲区都是一页
+    std::vector<Entry> seq_entries, random_entries;
+    auto mmap_entry = [](int advice)
+    {
+        return [advice](const std::string &f, std::size_t, const std::vector<std::size_t> *o)
+        { return mmap_read(f, advice, o); };
+    };
+    for (auto *entries : {&seq_entries, &random_entries})
+    {
+        entries->push_back({"mmap", mmap_entry(-1), false});
+        entries->push_back({"mmap+MADV_SEQUENTIAL", mmap_entry(MADV_SEQUENTIAL), false});
+        entries->push_back({"mmap+MADV_RANDOM", mmap_entry(MADV_RANDOM), false});
+        entries->push_back({"mmap+MADV_WILLNEED", mmap_entry(MADV_WILLNEED), false});
+    }
+    auto pread_entry = [](std::size_t bufsize, int flags)
+    {
+        return [bufsize, flags](const std::string &f, std::size_t, const std::vector<std::size_t> *o)
+        { return pread_read(f, bufsize, flags, o); };
+    };
+    auto ifstream_entry = [](std::size_t bufsize)
+    {
+        return [bufsize](const std::string &f, std::size_t, const std::vector<std::size_t> *o)
+        { return ifstream_read(f, bufsize, o); };
+    };
+    seq_entries.push_back({"pread 4K", pread_entry(4 << 10, 0), false});
+    seq_entries.push_back({"pread 64K", pread_entry(64 << 10, 0), false});
+    seq_entries.push_back({"pread 1M", pread_entry(1 << 20, 0), false});
+    seq_entries.push_back({"pread 16M", pread_entry(16 << 20, 0), false});
+    seq_entries.push_back({"ifstream 64K", ifstream_entry(64 << 10), false});
+    seq_entries.push_back({"O_DIRECT pread 1M", pread_entry(1 << 20, O_DIRECT), true});
+    seq_entries.push_back({"O_DIRECT pread 16M", pread_entry(16 << 20, O_DIRECT), true});
+    random_entries.push_back({"pread 4K", pread_entry(page, 0), false});
+    random_entries.push_back({"ifstream 4K", ifstream_entry(page), false});
+    random_entries.push_back({"O_DIRECT pread 4K", pread_entry(page, O_DIRECT), true});
+
+    auto offsets = random_offsets(file_size);
+    for (bool cold : {true, false})
+    {
+        for (auto &e : seq_entries)
+        {
+            if (cold || !e.direct)
+                run(e.name, filename, file_size, cold, nullptr, e.method);
+        }
+        for (auto &e : random_entries)
+        {
+            if (cold || !e.direct)
+                run(e.name, filename, file_size, cold, &offsets, e.method);
+        }
+    }
+
+    if (temporary)
+        std::remove(filename.c_str());
+    return 0;
+}
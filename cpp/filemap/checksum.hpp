@@ -0,0 +1,292 @@
+#pragma once
+#ifndef UTIL_CHECKSUM_HPP
+#define UTIL_CHECKSUM_HPP
+
+#include "filemap.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
+namespace util
+{
+
+enum class ChecksumKind
+{
+    CRC32C, // 与 `crc32c` 命令的结果一致，编译时开启 SSE4.2 (`-msse4.2`) 则使用硬件指令
+    XXH64   // 分块计算 XXH64 再合并，只有一块时与 `xxh64sum` 一致
+};
+
+namespace checksum_detail
+{
+
+inline constexpr uint32_t crc32c_poly = 0x82F63B78u;
+
+inline constexpr std::array<uint32_t, 256> make_crc32c_table()
+{
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+        uint32_t crc = i;
+        for (int k = 0; k < 8; ++k)
+            crc = (crc & 1) ? (crc >> 1) ^ crc32c_poly : crc >> 1;
+        table[i] = crc;
+    }
+    return table;
+}
+
+inline constexpr std::array<uint32_t, 256> crc32c_table = make_crc32c_table();
+
+// 在 GF(2) 上计算 a*b mod P，多项式用反射的比特序表示
+inline uint32_t crc32c_multmodp(uint32_t a, uint32_t b)
+{
+    uint32_t m = 1u << 31, p = 0;
+    for (;;)
+    {
+        if (a & m)
+        {
+            p ^= b;
+            if ((a & (m - 1)) == 0)
+                break;
+        }
+        m >>= 1;
+        b = (b & 1) ? (b >> 1) ^ crc32c_poly : b >> 1;
+    }
+    return p;
+}
+
+// x^(n*2^k) mod P
+inline uint32_t crc32c_x2nmodp(uint64_t n, unsigned k)
+{
+    static const std::array<uint32_t, 32> x2n_table = []()
+    {
+        std::array<uint32_t, 32> table{};
+        uint32_t p = 1u << 30; // x^1
+        table[0] = p;
+        for (int i = 1; i < 32; ++i)
+            table[i] = p = crc32c_multmodp(p, p);
+        return table;
+    }();
+    uint32_t p = 1u << 31; // x^0
+    while (n)
+    {
+        if (n & 1)
+            p = crc32c_multmodp(x2n_table[k & 31], p);
+        n >>= 1;
+        ++k;
+    }
+    return p;
+}
+
+inline uint64_t read64(const unsigned char *p)
+{
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t read32(const unsigned char *p)
+{
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+inline constexpr uint64_t xxh_prime1 = 0x9E3779B185EBCA87ull;
+inline constexpr uint64_t xxh_prime2 = 0xC2B2AE3D27D4EB4Full;
+inline constexpr uint64_t xxh_prime3 = 0x165667B19E3779F9ull;
+inline constexpr uint64_t xxh_prime4 = 0x85EBCA77C2B2AE63ull;
+inline constexpr uint64_t xxh_prime5 = 0x27D4EB2F165667C5ull;
+
+inline uint64_t xxh64_round(uint64_t acc, uint64_t input)
+{
+    acc += input * xxh_prime2;
+    acc = rotl64(acc, 31);
+    return acc * xxh_prime1;
+}
+
+inline uint64_t xxh64_merge_round(uint64_t acc, uint64_t val)
+{
+    acc ^= xxh64_round(0, val);
+    return acc * xxh_prime1 + xxh_prime4;
+}
+
+// 把 [0, n) 切成 parts 段，第 i 段的起点
+inline std::size_t split_point(std::size_t n, std::size_t parts, std::size_t i)
+{
+    return n / parts * i + std::min(i, n % parts);
+}
+
+inline unsigned default_threads(unsigned threads)
+{
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    return threads == 0 ? 1 : threads;
+}
+
+} // namespace checksum_detail
+
+// 增量计算 CRC32C，`crc` 是前面数据的结果
+inline uint32_t crc32c(const void *data, std::size_t size, uint32_t crc = 0)
+{
+    auto p = static_cast<const unsigned char *>(data);
+    crc = ~crc;
+#ifdef __SSE4_2__
+    uint64_t crc64 = crc;
+    for (; size >= 8; size -= 8, p += 8)
+        crc64 = _mm_crc32_u64(crc64, checksum_detail::read64(p));
+    crc = static_cast<uint32_t>(crc64);
+    for (; size > 0; --size, ++p)
+        crc = _mm_crc32_u8(crc, *p);
+#else
+    for (; size > 0; --size, ++p)
+        crc = checksum_detail::crc32c_table[(crc ^ *p) & 0xFF] ^ (crc >> 8);
+#endif
+    return ~crc;
+}
+
+// 已知 crc1 = crc32c(A), crc2 = crc32c(B)，计算 crc32c(A + B)，`size2` 是 B 的长度
+inline uint32_t crc32c_combine(uint32_t crc1, uint32_t crc2, uint64_t size2)
+{
+    return checksum_detail::crc32c_multmodp(checksum_detail::crc32c_x2nmodp(size2, 3), crc1) ^ crc2;
+}
+
+inline uint64_t xxh64(const void *data, std::size_t size, uint64_t seed = 0)
+{
+    using namespace checksum_detail;
+    auto p = static_cast<const unsigned char *>(data);
+    auto end = p + size;
+    uint64_t h64;
+    if (size >= 32)
+    {
+        uint64_t v1 = seed + xxh_prime1 + xxh_prime2;
+        uint64_t v2 = seed + xxh_prime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - xxh_prime1;
+        for (; end - p >= 32; p += 32)
+        {
+            v1 = xxh64_round(v1, read64(p));
+            v2 = xxh64_round(v2, read64(p + 8));
+            v3 = xxh64_round(v3, read64(p + 16));
+            v4 = xxh64_round(v4, read64(p + 24));
+        }
+        h64 = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h64 = xxh64_merge_round(h64, v1);
+        h64 = xxh64_merge_round(h64, v2);
+        h64 = xxh64_merge_round(h64, v3);
+        h64 = xxh64_merge_round(h64, v4);
+    }
+    else
+    {
+        h64 = seed + xxh_prime5;
+    }
+    h64 += static_cast<uint64_t>(size);
+    for (; end - p >= 8; p += 8)
+    {
+        h64 ^= xxh64_round(0, read64(p));
+        h64 = rotl64(h64, 27) * xxh_prime1 + xxh_prime4;
+    }
+    if (end - p >= 4)
+    {
+        h64 ^= static_cast<uint64_t>(read32(p)) * xxh_prime1;
+        h64 = rotl64(h64, 23) * xxh_prime2 + xxh_prime3;
+        p += 4;
+    }
+    for (; p < end; ++p)
+    {
+        h64 ^= (*p) * xxh_prime5;
+        h64 = rotl64(h64, 11) * xxh_prime1;
+    }
+    h64 ^= h64 >> 33;
+    h64 *= xxh_prime2;
+    h64 ^= h64 >> 29;
+    h64 *= xxh_prime3;
+    h64 ^= h64 >> 32;
+    return h64;
+}
+
+// 多线程计算一块内存的校验和，`threads = 0` 表示使用全部硬件线程。
+// CRC32C 各线程分别计算连续的一段，再用 `crc32c_combine` 按顺序合并，结果与单线程完全一致。
+// XXH64 按固定的 `block_size` 分块，再对各块的结果（小端序）计算一次 XXH64，
+// 因此结果只依赖于 `block_size`，与线程数无关。
+inline uint64_t checksum(const void *data, std::size_t size, ChecksumKind kind = ChecksumKind::CRC32C,
+                         unsigned threads = 0, std::size_t block_size = std::size_t(1) << 24)
+{
+    using checksum_detail::split_point;
+    auto p = static_cast<const unsigned char *>(data);
+    threads = checksum_detail::default_threads(threads);
+    if (kind == ChecksumKind::CRC32C)
+    {
+        // 太小的数据不值得开线程
+        std::size_t parts = std::max<std::size_t>(1, std::min<std::size_t>(threads, size >> 20));
+        std::vector<uint32_t> crcs(parts);
+        std::vector<std::thread> pool;
+        for (std::size_t i = 1; i < parts; ++i)
+        {
+            pool.emplace_back(
+                [&, i]()
+                {
+                    auto first = split_point(size, parts, i), last = split_point(size, parts, i + 1);
+                    crcs[i] = crc32c(p + first, last - first);
+                });
+        }
+        crcs[0] = crc32c(p, split_point(size, parts, 1));
+        for (auto &th : pool)
+            th.join();
+        uint32_t crc = crcs[0];
+        for (std::size_t i = 1; i < parts; ++i)
+            crc = crc32c_combine(crc, crcs[i], split_point(size, parts, i + 1) - split_point(size, parts, i));
+        return crc;
+    }
+
+    if (block_size == 0 || size <= block_size)
+        return xxh64(p, size);
+    std::size_t blocks = (size + block_size - 1) / block_size;
+    std::size_t parts = std::min<std::size_t>(threads, blocks);
+    std::vector<uint64_t> digests(blocks);
+    auto work = [&](std::size_t i)
+    {
+        for (std::size_t b = split_point(blocks, parts, i); b < split_point(blocks, parts, i + 1); ++b)
+        {
+            std::size_t first = b * block_size;
+            digests[b] = xxh64(p + first, std::min(block_size, size - first));
+        }
+    };
+    std::vector<std::thread> pool;
+    for (std::size_t i = 1; i < parts; ++i)
+        pool.emplace_back(work, i);
+    work(0);
+    for (auto &th : pool)
+        th.join();
+    std::vector<unsigned char> buf(blocks * 8);
+    for (std::size_t b = 0; b < blocks; ++b)
+    {
+        for (int k = 0; k < 8; ++k)
+            buf[b * 8 + k] = static_cast<unsigned char>(digests[b] >> (8 * k));
+    }
+    return xxh64(buf.data(), buf.size());
+}
+
+// 文件打开或映射失败时抛出异常，空文件返回空数据的校验和
+inline uint64_t checksum(const FileMapReader &file, ChecksumKind kind = ChecksumKind::CRC32C, unsigned threads = 0,
+                         std::size_t block_size = std::size_t(1) << 24)
+{
+    if (!file.good())
+        throw std::runtime_error("checksum: " + file.error_msg());
+    if (file.file_size() == 0)
+        return checksum(nullptr, 0, kind, threads, block_size);
+    return checksum(file.data(), file.file_size(), kind, threads, block_size);
+}
+
+} // namespace util
+
+#endif // UTIL_CHECKSUM_HPP
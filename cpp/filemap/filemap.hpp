@@ -8,7 +8,11 @@
 #ifdef _WIN64
 #include <windows.h>
 #elif __linux__
+#include <cerrno>
+#include <chrono>
 #include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -38,6 +42,11 @@ class FileMapReader
             return;
         }
         m_file_size = fsize.QuadPart;
+        // 空文件无法映射，视为正常的空数据
+        if (m_file_size == 0)
+        {
+            return;
+        }
 
         m_hmap = CreateFileMappingA(m_hfile, NULL, PAGE_READONLY, 0, 0, NULL);
         if (m_hmap == NULL)
@@ -79,9 +88,9 @@ class FileMapReader
     FileMapReader(FileMapReader &&) = delete;
     FileMapReader &operator=(FileMapReader &&) = delete;
 
-    HANDLE m_hfile, m_hmap;
-    void *m_data;
-    std::size_t m_file_size;
+    HANDLE m_hfile = INVALID_HANDLE_VALUE, m_hmap = NULL;
+    void *m_data = NULL;
+    std::size_t m_file_size = 0;
     std::string m_error_msg;
 };
 #elif __linux__
@@ -109,6 +118,11 @@ class FileMapReader
             m_error_msg = "File is not a regular file: " + filename;
             return;
         }
+        // 空文件无法映射，视为正常的空数据
+        if (m_file_size == 0)
+        {
+            return;
+        }
 
         m_data = mmap(NULL, m_file_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
         if (m_data == MAP_FAILED)
@@ -131,7 +145,7 @@ class FileMapReader
 
     bool good() const { return m_error_msg.empty(); }
     const std::string &error_msg() const { return m_error_msg; }
-    const void *data() const { return m_data; }
+    const void *data() const { return m_data == MAP_FAILED ? nullptr : m_data; }
     std::size_t file_size() const { return m_file_size; }
 
   private:
@@ -140,9 +154,182 @@ class FileMapReader
     FileMapReader(FileMapReader &&) = delete;
     FileMapReader &operator=(FileMapReader &&) = delete;
 
-    int m_fd;
-    void *m_data;
-    std::size_t m_file_size;
+    int m_fd = -1;
+    void *m_data = MAP_FAILED;
+    std::size_t m_file_size = 0;
+    std::string m_error_msg;
+};
+
+// 追加到文件末尾的一段字节，`data` 指向映射中的 `offset` 处
+struct FileMapRange
+{
+    const char *data;
+    std::size_t offset;
+    std::size_t size;
+
+    bool empty() const { return size == 0; }
+};
+
+// 跟踪一个正在被写入的文件（类似 `tail -f`），用 inotify 等待文件变化，
+// 文件变长时扩展映射，并只返回新追加的部分，已经读过的内容不会再被读取。
+// 注意：扩展映射可能会移动映射地址，之前返回的 `FileMapRange::data` 会失效。
+class FileMapFollower
+{
+  public:
+    FileMapFollower(const std::string &filename) : m_filename(filename)
+    {
+        m_fd = open(filename.c_str(), O_RDONLY);
+        if (m_fd == -1)
+        {
+            m_error_msg = "Failed to open file: " + filename;
+            return;
+        }
+        struct stat st;
+        if (fstat(m_fd, &st) == -1)
+        {
+            m_error_msg = "Failed to get file size: " + filename;
+            return;
+        }
+        if (!S_ISREG(st.st_mode))
+        {
+            m_error_msg = "File is not a regular file: " + filename;
+            return;
+        }
+        m_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (m_inotify_fd == -1 || inotify_add_watch(m_inotify_fd, filename.c_str(), IN_MODIFY | IN_CLOSE_WRITE) == -1)
+        {
+            m_error_msg = "Failed to watch file: " + filename;
+            return;
+        }
+        remap(st.st_size);
+    }
+    ~FileMapFollower()
+    {
+        if (m_data != MAP_FAILED)
+        {
+            munmap(m_data, m_file_size);
+        }
+        if (m_inotify_fd != -1)
+        {
+            close(m_inotify_fd);
+        }
+        if (m_fd != -1)
+        {
+            close(m_fd);
+        }
+    }
+
+    bool good() const { return m_error_msg.empty(); }
+    const std::string &error_msg() const { return m_error_msg; }
+    const void *data() const { return m_data == MAP_FAILED ? nullptr : m_data; }
+    std::size_t file_size() const { return m_file_size; }
+    // 已经通过 `poll`/`wait` 返回过的字节数
+    std::size_t consumed() const { return m_consumed; }
+
+    // 不等待，返回自上次调用以来追加的内容（可能为空）
+    FileMapRange poll() { return wait(0); }
+
+    // 等待文件增长，最多等待 `timeout_ms` 毫秒，负数表示一直等待。只有超时或者出错（见 `good()`）时返回空的范围。
+    // 如果文件被截断（例如日志被轮转覆盖），从新文件的开头重新开始。
+    FileMapRange wait(int timeout_ms = -1)
+    {
+        if (!good())
+            return FileMapRange{nullptr, m_consumed, 0};
+        // 先检查一次，文件可能在上次调用之后、没有等待的时候已经变长
+        if (!refresh())
+            return FileMapRange{nullptr, m_consumed, 0};
+        // 收到事件不代表文件变长了（之前残留的事件、IN_CLOSE_WRITE、只改了元数据等），
+        // 所以一直等到文件变长或者超时，每次重新计算剩余的等待时间
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        while (m_file_size == m_consumed && timeout_ms != 0)
+        {
+            int remaining = -1;
+            if (timeout_ms > 0)
+            {
+                auto left = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+                if (left.count() <= 0)
+                    break;
+                remaining = static_cast<int>(left.count());
+            }
+            struct pollfd pfd = {m_inotify_fd, POLLIN, 0};
+            int ready = ::poll(&pfd, 1, remaining);
+            if (ready < 0 && errno != EINTR)
+            {
+                m_error_msg = "Failed to wait for file: " + m_filename;
+                return FileMapRange{nullptr, m_consumed, 0};
+            }
+            if (ready > 0)
+                drain_events();
+            if (!refresh())
+                return FileMapRange{nullptr, m_consumed, 0};
+        }
+        FileMapRange range{static_cast<const char *>(data()) + m_consumed, m_consumed, m_file_size - m_consumed};
+        m_consumed = m_file_size;
+        return range;
+    }
+
+  private:
+    FileMapFollower(const FileMapFollower &) = delete;
+    FileMapFollower &operator=(const FileMapFollower &) = delete;
+    FileMapFollower(FileMapFollower &&) = delete;
+    FileMapFollower &operator=(FileMapFollower &&) = delete;
+
+    void drain_events()
+    {
+        alignas(struct inotify_event) char buf[4096];
+        while (read(m_inotify_fd, buf, sizeof(buf)) > 0)
+        {}
+    }
+
+    bool refresh()
+    {
+        struct stat st;
+        if (fstat(m_fd, &st) == -1)
+        {
+            m_error_msg = "Failed to get file size: " + m_filename;
+            return false;
+        }
+        std::size_t new_size = st.st_size;
+        if (new_size == m_file_size)
+            return true;
+        if (new_size < m_consumed)
+            m_consumed = 0;
+        return remap(new_size);
+    }
+
+    bool remap(std::size_t new_size)
+    {
+        // 长度为零的文件不能映射，等它有内容了再映射
+        if (new_size == 0)
+        {
+            if (m_data != MAP_FAILED)
+                munmap(m_data, m_file_size);
+            m_data = MAP_FAILED;
+        }
+        else if (m_data == MAP_FAILED)
+        {
+            m_data = mmap(NULL, new_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+        }
+        else
+        {
+            m_data = mremap(m_data, m_file_size, new_size, MREMAP_MAYMOVE);
+        }
+        if (new_size != 0 && m_data == MAP_FAILED)
+        {
+            m_file_size = 0;
+            m_error_msg = "Failed to map view of file: " + m_filename;
+            return false;
+        }
+        m_file_size = new_size;
+        return true;
+    }
+
+    std::string m_filename;
+    int m_fd = -1;
+    int m_inotify_fd = -1;
+    void *m_data = MAP_FAILED;
+    std::size_t m_file_size = 0;
+    std::size_t m_consumed = 0;
     std::string m_error_msg;
 };
 
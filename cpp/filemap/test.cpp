@@ -0,0 +1,77 @@
+#include "checksum.hpp"
+#include "filemap.hpp"
+#include <fstream>
+#include <thread>
+
+using namespace util;
+
+int main(int argc, char const *argv[])
+{
+    const char *filename = "filemap_test.txt";
+    std::ofstream(filename) << "line 0\n";
+    {
+        FileMapReader reader(filename);
+        if (!reader.good())
+        {
+            std::cerr << reader.error_msg() << std::endl;
+            return 1;
+        }
+        std::cout << "reader: " << std::string(static_cast<const char *>(reader.data()), reader.file_size());
+        std::cout << std::hex << "crc32c = " << checksum(reader) << ", xxh64 = " << checksum(reader, ChecksumKind::XXH64)
+                  << std::dec << std::endl;
+    }
+    {
+        const char *empty = "filemap_empty.txt";
+        std::ofstream{empty};
+        FileMapReader reader(empty);
+        std::cout << std::hex << "empty crc32c = " << checksum(reader) << std::dec << std::endl;
+        std::remove(empty);
+        try
+        {
+            FileMapReader missing("filemap_missing.txt");
+            checksum(missing);
+        }
+        catch (const std::runtime_error &e)
+        {
+            std::cout << e.what() << std::endl;
+        }
+    }
+
+#ifdef __linux__
+    FileMapFollower follower(filename);
+    if (!follower.good())
+    {
+        std::cerr << follower.error_msg() << std::endl;
+        return 1;
+    }
+    std::thread writer(
+        [filename]()
+        {
+            std::ofstream ofs(filename, std::ios::app);
+            for (int i = 1; i <= 5; ++i)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                ofs << "line " << i << std::endl;
+            }
+        });
+    // 初始的一行加上追加的 5 行，每行 7 个字节，读够为止
+    const std::size_t expected = 6 * 7;
+    std::size_t total = 0;
+    while (total < expected)
+    {
+        auto range = follower.wait(5000);
+        if (range.empty())
+        {
+            std::cerr << "follower timed out after " << total << " bytes" << std::endl;
+            writer.join();
+            std::remove(filename);
+            return 1;
+        }
+        total = range.offset + range.size;
+        std::cout << "follower [" << range.offset << ", " << total << "): " << std::string(range.data, range.size);
+    }
+    writer.join();
+#endif
+    std::remove(filename);
+    return 0;
+}
@@ -0,0 +1,147 @@
+// 测试 Logger 的吞吐量（条/秒）和单次调用的延迟分布。
+// 分别测试同步、异步模式，`log_xxx`和`log_deferred`，短消息和长消息，以及级别没有打开时的开销，
+// 输出到 /dev/null 和文件，单线程和多线程。
+//
+// 编译: g++ -std=c++17 -O2 -pthread bench.cpp -o bench
+// 运行: ./bench [records_per_thread] [threads]
+//   默认每个线程 100000 条，多线程的线程数默认为硬件线程数（最多 8）。
+//   吞吐量包括最后等待异步线程写完的时间；延迟是每次调用的耗时，包含两次读时钟的开销（约几十纳秒）。
+//   写文件的测试会在当前目录生成 logger_bench.log，结束后删除。
+#include "logger.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace util;
+
+namespace
+{
+
+const std::string long_text(200, 'x');
+
+struct Case
+{
+    const char *name;
+    bool disabled; // 级别没有打开，与输出方式无关，只测一次
+    std::function<void(int, int)> call;
+};
+
+struct Result
+{
+    double records_per_sec;
+    long long p50, p99, p999, max;
+};
+
+Result run(const Case &c, int threads, int records)
+{
+    std::vector<std::vector<long long>> latency(threads, std::vector<long long>(records));
+    std::atomic<int> ready{0};
+    std::atomic<bool> go{false};
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; ++t)
+    {
+        pool.emplace_back(
+            [&, t]()
+            {
+                auto &lat = latency[t];
+                ready.fetch_add(1);
+                while (!go.load(std::memory_order_acquire))
+                    std::this_thread::yield();
+                for (int i = 0; i < records; ++i)
+                {
+                    auto begin = std::chrono::steady_clock::now();
+                    c.call(t, i);
+                    lat[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                                                  begin)
+                                 .count();
+                }
+            });
+    }
+    while (ready.load() < threads)
+        std::this_thread::yield();
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto &th : pool)
+        th.join();
+    log_flush();
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<long long> all;
+    all.reserve(static_cast<std::size_t>(threads) * records);
+    for (auto &lat : latency)
+        all.insert(all.end(), lat.begin(), lat.end());
+    std::sort(all.begin(), all.end());
+    auto at = [&](double q) { return all[std::min(all.size() - 1, static_cast<std::size_t>(q * all.size()))]; };
+    return Result{all.size() / sec, at(0.5), at(0.99), at(0.999), all.back()};
+}
+
+} // namespace
+
+int main(int argc, char const *argv[])
+{
+    int records = argc > 1 ? std::atoi(argv[1]) : 100000;
+    int max_threads = argc > 2 ? std::atoi(argv[2]) : std::min(8u, std::max(1u, std::thread::hardware_concurrency()));
+    if (records <= 0 || max_threads <= 0)
+    {
+        std::fprintf(stderr, "usage: %s [records_per_thread] [threads]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<Case> cases = {
+        {"log_info short", false, [](int t, int i) { log_info("iter ", i, " thread ", t); }},
+        {"log_info long", false, [](int, int i) { log_info(long_text, " iter ", i, " residual ", 1.0 / (i + 1)); }},
+        {"log_deferred short", false, [](int t, int i) { log_deferred<LogLevel::Info>("iter {} thread {}", i, t); }},
+        {"log_deferred long", false,
+         [](int, int i)
+         {
+             log_deferred<LogLevel::Info>("xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx"
+                                          "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx"
+                                          "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx"
+                                          "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx iter {} residual {}",
+                                          i, 1.0 / (i + 1));
+         }},
+        {"log_debug (disabled)", true, [](int, int i) { log_debug("iter ", i); }},
+        {"UTIL_LOG_DEBUG (disabled)", true, [](int, int i) { UTIL_LOG_DEBUG("iter ", std::to_string(i)); }},
+    };
+    std::vector<int> thread_counts = {1};
+    if (max_threads > 1)
+        thread_counts.push_back(max_threads);
+    const char *log_file = "logger_bench.log";
+
+    std::printf("%-26s %-5s %-9s %7s %14s %8s %8s %8s %10s\n", "case", "mode", "output", "threads", "records/s",
+                "p50(ns)", "p99", "p99.9", "max");
+    for (const char *output : {"/dev/null", log_file})
+    {
+        for (bool async : {false, true})
+        {
+            for (auto &c : cases)
+            {
+                if (c.disabled && (async || output == log_file))
+                    continue;
+                for (int threads : thread_counts)
+                {
+                    // 每次重新创建文件，不同的测试之间互不影响
+                    Logger::instance().clear_sinks();
+                    if (output == log_file)
+                        std::remove(log_file);
+                    Logger::instance().add_sink(std::make_shared<FileSink>(output));
+                    if (async)
+                        log_init_async(LogLevel::Info);
+                    else
+                        log_init(LogLevel::Info);
+                    auto r = run(c, threads, records);
+                    std::printf("%-26s %-5s %-9s %7d %14.0f %8lld %8lld %8lld %10lld\n", c.name,
+                                async ? "async" : "sync", c.disabled ? "-" : (output == log_file ? "file" : "null"),
+                                threads, r.records_per_sec, r.p50, r.p99, r.p999, r.max);
+                    std::fflush(stdout);
+                }
+            }
+        }
+    }
+    Logger::instance().clear_sinks();
+    std::remove(log_file);
+    return 0;
+}
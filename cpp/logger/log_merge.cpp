@@ -0,0 +1,128 @@
+// 按时间戳合并多个进程的日志文件（见 `log_route_per_process`），输出到标准输出。
+//
+// 编译: g++ -std=c++17 -O2 log_merge.cpp -o log_merge
+// 运行: ./log_merge [-t] log.*.log > merged.log
+//   -t  在每行前面加上来源文件名
+//
+// 三种记录格式都可以合并：Text 格式的日志以`[时间]`开头，不以`[`开头的行属于上一条日志；
+// logfmt 和 JSON 格式每行一条，分别以`time="时间"`和`{"time":"时间"`开头。时间按字符串比较，
+// 所以各文件应使用相同的、定宽的时间格式，`WallClock`系列最合适；相同时间的日志按文件在命令行中的顺序输出。
+// 每个文件只缓存一条日志，可以合并任意大的文件。
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+// 如果 `line` 是一条日志的开头，取出它的时间
+bool record_key(const std::string &line, std::string &key)
+{
+    std::size_t begin, end;
+    if (!line.empty() && line[0] == '[')
+    {
+        begin = 1;
+        end = line.find(']');
+    }
+    else if (line.compare(0, 6, "time=\"") == 0 || line.compare(0, 9, "{\"time\":\"") == 0)
+    {
+        begin = line[0] == '{' ? 9 : 6;
+        end = line.find('"', begin);
+    }
+    else
+    {
+        return false;
+    }
+    key = end != std::string::npos ? line.substr(begin, end - begin) : std::string();
+    return true;
+}
+
+struct Source
+{
+    std::string name;
+    std::ifstream ifs;
+    std::string next_line; // 已经读出来的下一条日志的第一行
+    bool has_next = false;
+    std::string record;    // 当前日志，可能有多行
+    std::string key;       // 当前日志的时间
+
+    // 读取下一条日志，文件结束返回 false
+    bool advance()
+    {
+        if (!has_next && !(has_next = static_cast<bool>(std::getline(ifs, next_line))))
+            return false;
+        record = next_line + '\n';
+        has_next = false;
+        if (!record_key(next_line, key))
+            key.clear();
+        std::string next_key;
+        while ((has_next = static_cast<bool>(std::getline(ifs, next_line))))
+        {
+            if (record_key(next_line, next_key))
+                break;
+            record += next_line;
+            record += '\n';
+        }
+        return true;
+    }
+};
+
+} // namespace
+
+int main(int argc, char const *argv[])
+{
+    bool tag = false;
+    std::vector<std::unique_ptr<Source>> sources;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "-t")
+        {
+            tag = true;
+            continue;
+        }
+        auto src = std::make_unique<Source>();
+        src->name = arg;
+        src->ifs.open(arg);
+        if (!src->ifs)
+        {
+            std::cerr << "Failed to open file: " << arg << '\n';
+            return 1;
+        }
+        sources.push_back(std::move(src));
+    }
+    if (sources.empty())
+    {
+        std::cerr << "usage: " << argv[0] << " [-t] file...\n";
+        return 1;
+    }
+
+    auto later = [&](std::size_t a, std::size_t b)
+    {
+        if (sources[a]->key != sources[b]->key)
+            return sources[a]->key > sources[b]->key;
+        return a > b;
+    };
+    std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(later)> heap(later);
+    for (std::size_t i = 0; i < sources.size(); ++i)
+    {
+        if (sources[i]->advance())
+            heap.push(i);
+    }
+    std::ios::sync_with_stdio(false);
+    while (!heap.empty())
+    {
+        std::size_t i = heap.top();
+        heap.pop();
+        auto &src = *sources[i];
+        if (tag)
+            std::cout << src.name << ": ";
+        std::cout << src.record;
+        if (src.advance())
+            heap.push(i);
+    }
+    return 0;
+}
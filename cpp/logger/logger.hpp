@@ -2,10 +2,36 @@
 #ifndef UTIL_LOGGER_HPP
 #define UTIL_LOGGER_HPP
 
+#include <atomic>
+#include <charconv>
 #include <chrono>
-#include <iomanip>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <functional>
 #include <iostream>
-#include <sstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 namespace util
 {
@@ -19,6 +45,961 @@ enum class LogLevel
     Verbose = 4
 };
 
+// 编译期的最低日志级别，低于该级别的日志调用会被完全消除，例如 release 构建时用
+// `-DUTIL_LOG_MIN_LEVEL=2` 只保留 Error/Warning/Info。默认全部保留。
+#ifndef UTIL_LOG_MIN_LEVEL
+#define UTIL_LOG_MIN_LEVEL 4
+#endif
+
+template <LogLevel level>
+inline constexpr bool log_compiled = static_cast<int>(level) <= UTIL_LOG_MIN_LEVEL;
+
+// 异步模式下缓冲区满了的时候怎么办
+enum class LogFullPolicy
+{
+    Block, // 等待后台线程腾出空间
+    Drop,  // 丢弃这条日志，后台线程会报告丢弃了多少条
+    Grow   // 放进一个额外的无界队列
+};
+
+// 每条日志的输出格式
+enum class LogRecordFormat
+{
+    Text,   // [时间] 消息 key=value，默认
+    Logfmt, // time="时间" level=info msg="消息" key=value
+    Json    // {"time":"时间","level":"info","msg":"消息","key":value}
+};
+
+// 结构化日志的一个字段，由 `kv` 构造，只在日志调用期间引用 `value`
+template <typename T>
+struct LogField
+{
+    const char *key;
+    const T &value;
+};
+
+// `log_info("step done", kv("iter", iter), kv("res", res))`，值可以是数值、bool 或者字符串。
+// 字段直接用 `std::to_chars` 格式化，浮点数输出能精确还原的最短形式。`key` 不做转义。
+template <typename T>
+inline LogField<T> kv(const char *key, const T &value)
+{
+    return LogField<T>{key, value};
+}
+
+namespace logger_detail
+{
+
+// 延迟格式化的日志只保存参数的原始字节，由后台线程用对应参数类型的函数格式化
+inline constexpr std::size_t deferred_capacity = 64;
+using DeferredFormatter = void (*)(std::ostream &, const char *, const unsigned char *);
+// 异步模式下不超过这个长度的普通日志直接存在队列的记录里，不需要分配内存
+inline constexpr std::size_t inline_text_capacity = 128;
+
+struct LogRecord
+{
+    LogLevel level;
+    // 单调时钟，墙上时间由 Logger 根据初始化时的对应关系换算
+    std::chrono::steady_clock::time_point time;
+    // 放不进 `text` 的普通日志。记录在写入的线程返回之后才输出，不能引用它的缓冲区，只能复制
+    std::string msg;
+    // `format` 和 `deferred` 都是每个调用点固定的，合起来就是调用点的标识
+    const char *format = nullptr;
+    DeferredFormatter deferred = nullptr;
+    unsigned char args[deferred_capacity] = {};
+    std::size_t text_size = 0;
+    char text[inline_text_capacity] = {};
+
+    void set_message(const std::string &s)
+    {
+        if (s.size() <= inline_text_capacity)
+        {
+            std::memcpy(text, s.data(), s.size());
+            text_size = s.size();
+        }
+        else
+        {
+            msg = s;
+        }
+    }
+
+    void append_message(std::string &out) const
+    {
+        if (text_size > 0)
+            out.append(text, text_size);
+        else
+            out += msg;
+    }
+};
+
+// 输出 `fmt` 到下一个 `{}` 之前的部分，返回 `{}` 之后的位置，没有 `{}` 时返回 nullptr
+inline const char *format_until_placeholder(std::ostream &os, const char *fmt)
+{
+    const char *p = std::strstr(fmt, "{}");
+    if (p == nullptr)
+    {
+        os << fmt;
+        return nullptr;
+    }
+    os.write(fmt, p - fmt);
+    return p + 2;
+}
+
+template <typename T>
+struct type_tag
+{
+    using type = T;
+};
+
+// 依次用参数替换 `fmt` 中的 `{}`，多余的参数用空格隔开接在后面
+template <typename... Args>
+void format_deferred(std::ostream &os, const char *fmt, const unsigned char *args)
+{
+    auto one = [&](auto tag)
+    {
+        using T = typename decltype(tag)::type;
+        if (fmt == nullptr || (fmt = format_until_placeholder(os, fmt)) == nullptr)
+            os << ' ';
+        T value;
+        std::memcpy(&value, args, sizeof(T));
+        args += sizeof(T);
+        os << value;
+    };
+    (one(type_tag<Args>{}), ...);
+    if (fmt != nullptr)
+        os << fmt;
+}
+
+// 有界的无锁队列（Vyukov），多个线程写入，后台线程读出
+class LogQueue
+{
+  public:
+    explicit LogQueue(std::size_t capacity)
+    {
+        std::size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+        m_mask = size - 1;
+        m_cells.reset(new Cell[size]);
+        for (std::size_t i = 0; i < size; ++i)
+            m_cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    // 只有成功时才会移走 `rec`
+    bool try_push(LogRecord &rec)
+    {
+        Cell *cell;
+        std::size_t pos = m_tail.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell = &m_cells[pos & m_mask];
+            std::size_t seq = cell->seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0)
+            {
+                if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+        cell->rec = std::move(rec);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(LogRecord &rec)
+    {
+        std::size_t pos = m_head.load(std::memory_order_relaxed);
+        Cell *cell = &m_cells[pos & m_mask];
+        std::size_t seq = cell->seq.load(std::memory_order_acquire);
+        if (static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1) < 0)
+            return false;
+        // 只有一个读者，不需要 CAS
+        m_head.store(pos + 1, std::memory_order_relaxed);
+        rec = std::move(cell->rec);
+        cell->seq.store(pos + m_mask + 1, std::memory_order_release);
+        return true;
+    }
+
+  private:
+    struct Cell
+    {
+        std::atomic<std::size_t> seq;
+        LogRecord rec;
+    };
+    std::unique_ptr<Cell[]> m_cells;
+    std::size_t m_mask;
+    alignas(64) std::atomic<std::size_t> m_head{0};
+    alignas(64) std::atomic<std::size_t> m_tail{0};
+};
+
+// 后台写日志的线程，逐条交给 `handler` 格式化输出，每批结束后调用一次 `commit`（决定是否刷新）
+class AsyncLogWriter
+{
+  public:
+    using Handler = std::function<void(const LogRecord &)>;
+    using Committer = std::function<void()>;
+
+    AsyncLogWriter(std::size_t capacity, LogFullPolicy policy, Handler handler, Committer committer)
+        : m_queue(capacity), m_policy(policy), m_handler(std::move(handler)), m_committer(std::move(committer))
+    {
+        m_thread = std::thread([this]() { run(); });
+    }
+    ~AsyncLogWriter() { stop(); }
+
+    // 输出剩余的日志并结束后台线程
+    void stop()
+    {
+        if (!m_thread.joinable())
+            return;
+        m_closed.store(true, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cv.notify_one();
+        m_thread.join();
+        while (write_batch() > 0)
+        {}
+    }
+
+    void push(LogRecord &&rec)
+    {
+        if (m_policy == LogFullPolicy::Grow)
+        {
+            if (m_overflowing.load(std::memory_order_acquire) || !m_queue.try_push(rec))
+            {
+                std::lock_guard<std::mutex> lock(m_overflow_mutex);
+                m_overflow.push_back(std::move(rec));
+                m_overflowing.store(true, std::memory_order_release);
+            }
+        }
+        else if (m_policy == LogFullPolicy::Drop)
+        {
+            if (!m_queue.try_push(rec))
+            {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+        else
+        {
+            while (!m_queue.try_push(rec))
+            {
+                // 后台线程已经停止（重新 init 了），不能再等
+                if (m_closed.load(std::memory_order_relaxed))
+                    return;
+                m_cv.notify_one();
+                std::this_thread::yield();
+            }
+        }
+        m_pushed.fetch_add(1, std::memory_order_release);
+        if (m_idle.load(std::memory_order_relaxed))
+            m_cv.notify_one();
+    }
+
+    // 等到目前为止写入的日志都已经输出
+    void flush()
+    {
+        if (!m_thread.joinable())
+            return;
+        std::size_t target = m_pushed.load(std::memory_order_acquire);
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.notify_one();
+        m_flushed_cv.wait(lock, [&]() { return m_written >= target; });
+    }
+
+  private:
+    bool next(LogRecord &rec)
+    {
+        if (m_queue.try_pop(rec))
+            return true;
+        if (!m_overflowing.load(std::memory_order_acquire))
+            return false;
+        std::lock_guard<std::mutex> lock(m_overflow_mutex);
+        if (m_overflow.empty())
+            return false;
+        rec = std::move(m_overflow.front());
+        m_overflow.pop_front();
+        if (m_overflow.empty())
+            m_overflowing.store(false, std::memory_order_release);
+        return true;
+    }
+
+    std::size_t write_batch()
+    {
+        constexpr std::size_t max_batch = 1024;
+        std::size_t count = 0;
+        while (count < max_batch && next(m_record))
+        {
+            m_handler(m_record);
+            ++count;
+        }
+        if (std::size_t dropped = m_dropped.exchange(0, std::memory_order_relaxed))
+        {
+            // 和延迟格式化的日志一样作为普通消息，由 Logger 按记录格式（logfmt/JSON）编码
+            LogRecord notice{};
+            notice.level = LogLevel::Warning;
+            notice.time = std::chrono::steady_clock::now();
+            notice.format = "[logger] {} records dropped";
+            notice.deferred = &format_deferred<std::size_t>;
+            std::memcpy(notice.args, &dropped, sizeof(dropped));
+            m_handler(notice);
+        }
+        // 空闲时也调用，让按时间间隔刷新的输出有机会刷新
+        m_committer();
+        return count;
+    }
+
+    void run()
+    {
+        for (;;)
+        {
+            std::size_t count = write_batch();
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (count > 0)
+            {
+                m_written += count;
+                m_flushed_cv.notify_all();
+                continue;
+            }
+            if (m_stop)
+                break;
+            m_idle.store(true, std::memory_order_relaxed);
+            // 写入方不加锁，通知可能会错过，所以只等一小段时间
+            m_cv.wait_for(lock, std::chrono::milliseconds(10));
+            m_idle.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    LogQueue m_queue;
+    LogFullPolicy m_policy;
+    Handler m_handler;
+    Committer m_committer;
+    LogRecord m_record;
+
+    std::mutex m_overflow_mutex;
+    std::deque<LogRecord> m_overflow;
+    std::atomic<bool> m_overflowing{false};
+
+    std::atomic<std::size_t> m_pushed{0};
+    std::atomic<std::size_t> m_dropped{0};
+    std::atomic<bool> m_idle{false};
+    std::atomic<bool> m_closed{false};
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::condition_variable m_flushed_cv;
+    std::size_t m_written = 0;
+    bool m_stop = false;
+    std::thread m_thread;
+};
+
+// 把输出追加到 `std::string` 的 streambuf，清空时保留容量，避免每条日志都重新分配
+class LogStringBuf : public std::streambuf
+{
+  public:
+    std::string &str() { return m_str; }
+
+  protected:
+    int_type overflow(int_type ch) override
+    {
+        if (!traits_type::eq_int_type(ch, traits_type::eof()))
+            m_str.push_back(traits_type::to_char_type(ch));
+        return traits_type::not_eof(ch);
+    }
+    std::streamsize xsputn(const char *s, std::streamsize n) override
+    {
+        m_str.append(s, static_cast<std::size_t>(n));
+        return n;
+    }
+
+  private:
+    std::string m_str;
+};
+
+// 每个线程各自的格式化缓冲区
+struct LogThreadBuffer
+{
+    LogStringBuf buf;
+    std::ostream os{&buf};
+    const std::ios default_format{nullptr};
+
+    std::string &reset()
+    {
+        buf.str().clear();
+        os.clear();
+        os.copyfmt(default_format);
+        return buf.str();
+    }
+};
+
+inline LogThreadBuffer &thread_buffer()
+{
+    thread_local LogThreadBuffer tb;
+    return tb;
+}
+
+// 限频日志每个调用点的状态，静态变量，常量初始化
+struct LogCallSite
+{
+    std::atomic<std::uint64_t> count{0};
+    std::atomic<std::int64_t> last_ns{0};
+
+    bool every_n(std::uint64_t n) { return count.fetch_add(1, std::memory_order_relaxed) % (n == 0 ? 1 : n) == 0; }
+    bool first_n(std::uint64_t n)
+    {
+        // 超过 n 次之后只读不写，避免多个线程争抢同一个缓存行
+        return count.load(std::memory_order_relaxed) < n && count.fetch_add(1, std::memory_order_relaxed) < n;
+    }
+    bool every_ms(std::int64_t ms)
+    {
+        std::int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               std::chrono::steady_clock::now().time_since_epoch())
+                               .count();
+        std::int64_t last = last_ns.load(std::memory_order_relaxed);
+        if (last != 0 && now - last < ms * 1000000)
+            return false;
+        return last_ns.compare_exchange_strong(last, now, std::memory_order_relaxed);
+    }
+};
+
+// 以 1/n 的概率返回 true，每个线程有自己的随机数状态（xorshift64*）
+inline bool log_sample(std::uint64_t n)
+{
+    thread_local std::uint64_t state =
+        std::hash<std::thread::id>{}(std::this_thread::get_id()) * 0x9E3779B97F4A7C15ull | 1;
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return n <= 1 || (state * 0x2545F4914F6CDD1Dull) % n == 0;
+}
+
+// 写到 `p`，不足 `width` 位时左边补零
+inline char *append_padded(char *p, long long value, int width)
+{
+    char buf[24];
+    auto len = static_cast<int>(std::to_chars(buf, buf + sizeof(buf), value).ptr - buf);
+    for (int i = len; i < width; ++i)
+        *p++ = '0';
+    std::memcpy(p, buf, len);
+    return p + len;
+}
+
+// 飞行记录器：固定大小的无锁环形缓冲区，总是保存最近的若干条日志（包括没有输出的级别），
+// 在 `error_stop` 和致命信号时输出，给崩溃的任务留下上下文。每条只保存前 `text_size` 个字节。
+class FlightRecorder
+{
+  public:
+    static constexpr std::size_t text_size = 232;
+
+    FlightRecorder(std::size_t capacity, LogLevel level, const std::string &file) : m_level(level)
+    {
+        std::size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+        m_mask = size - 1;
+        m_slots.reset(new Slot[size]);
+        std::size_t n = std::min(file.size(), sizeof(m_file) - 1);
+        std::memcpy(m_file, file.data(), n);
+        m_file[n] = '\0';
+    }
+
+    bool captures(LogLevel level) const { return static_cast<int>(level) <= static_cast<int>(m_level); }
+    LogLevel level() const { return m_level; }
+
+    void record(LogLevel level, std::int64_t time_ns, const char *text, std::size_t size)
+    {
+        std::uint64_t pos = m_next.fetch_add(1, std::memory_order_relaxed);
+        Slot &slot = m_slots[pos & m_mask];
+        // seqlock：写入期间序号为奇数，读的一方据此跳过写了一半的记录。
+        // 缓冲区转了一圈时另一个线程可能还在写这个槽（或者已经写了更新的记录），这时丢弃这条
+        std::uint64_t seq = slot.seq.load(std::memory_order_relaxed);
+        if ((seq & 1) || seq > 2 * pos ||
+            !slot.seq.compare_exchange_strong(seq, 2 * pos + 1, std::memory_order_acquire))
+            return;
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.time_ns = time_ns;
+        slot.level = level;
+        slot.size = static_cast<std::uint32_t>(std::min(size, text_size));
+        std::memcpy(slot.text, text, slot.size);
+        slot.seq.store(2 * pos + 2, std::memory_order_release);
+    }
+
+    // 只使用异步信号安全的函数，可以在信号处理函数中调用
+    void dump() const
+    {
+#ifdef _WIN32
+        int fd = m_file[0] ? _open(m_file, _O_WRONLY | _O_CREAT | _O_TRUNC, 0644) : 2;
+#else
+        int fd = m_file[0] ? open(m_file, O_WRONLY | O_CREAT | O_TRUNC, 0644) : 2;
+#endif
+        if (fd < 0)
+            return;
+        std::uint64_t end = m_next.load(std::memory_order_acquire);
+        std::uint64_t begin = end > m_mask + 1 ? end - (m_mask + 1) : 0;
+        char line[text_size + 48];
+        const char header[] = "==== flight recorder: last log records ====\n";
+        write_fd(fd, header, sizeof(header) - 1);
+        for (std::uint64_t pos = begin; pos < end; ++pos)
+        {
+            const Slot &slot = m_slots[pos & m_mask];
+            std::uint64_t seq = slot.seq.load(std::memory_order_acquire);
+            if (seq != 2 * pos + 2)
+                continue;
+            std::int64_t time_ns = std::max<std::int64_t>(slot.time_ns, 0);
+            LogLevel level = slot.level;
+            std::uint32_t size = std::min<std::uint32_t>(slot.size, text_size);
+            char *p = line;
+            *p++ = '[';
+            *p++ = '+';
+            p = append_padded(p, time_ns / 1000000000, 1);
+            *p++ = '.';
+            p = append_padded(p, (time_ns % 1000000000) / 1000, 6);
+            *p++ = ']';
+            *p++ = ' ';
+            *p++ = "EWIDV"[static_cast<int>(level)];
+            *p++ = ' ';
+            std::memcpy(p, slot.text, size);
+            p += size;
+            *p++ = '\n';
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) != seq)
+                continue;
+            write_fd(fd, line, p - line);
+        }
+        const char footer[] = "==== end of flight recorder ====\n";
+        write_fd(fd, footer, sizeof(footer) - 1);
+        if (fd != 2)
+        {
+#ifdef _WIN32
+            _close(fd);
+#else
+            close(fd);
+#endif
+        }
+    }
+
+  private:
+    struct Slot
+    {
+        std::atomic<std::uint64_t> seq{0};
+        std::int64_t time_ns;
+        LogLevel level;
+        std::uint32_t size;
+        char text[text_size];
+    };
+
+    static void write_fd(int fd, const char *data, std::size_t size)
+    {
+#ifdef _WIN32
+        _write(fd, data, static_cast<unsigned>(size));
+#else
+        while (size > 0)
+        {
+            ssize_t n = write(fd, data, size);
+            if (n <= 0)
+                return;
+            data += n;
+            size -= n;
+        }
+#endif
+    }
+
+    LogLevel m_level;
+    std::unique_ptr<Slot[]> m_slots;
+    std::size_t m_mask;
+    char m_file[256];
+    alignas(64) std::atomic<std::uint64_t> m_next{0};
+};
+
+// 信号处理函数要用到，所以是全局的，开启之后不再释放
+inline std::atomic<FlightRecorder *> flight_recorder{nullptr};
+
+inline void flight_recorder_signal_handler(int sig)
+{
+    if (auto recorder = flight_recorder.load(std::memory_order_acquire))
+        recorder->dump();
+    // 恢复默认处理方式后重新触发，保留原本的退出状态和 core dump
+    std::signal(sig, SIG_DFL);
+    std::raise(sig);
+}
+
+inline const char *level_name(LogLevel level)
+{
+    static const char *const names[] = {"error", "warning", "info", "debug", "verbose"};
+    return names[static_cast<int>(level)];
+}
+
+// 按 JSON 的规则原地转义 `out` 从 `start` 开始的部分，logfmt 的带引号字符串也使用同样的规则。
+// 没有需要转义的字符时不做任何事
+inline void escape_tail(std::string &out, std::size_t start)
+{
+    auto width = [](unsigned char c) -> std::size_t
+    {
+        if (c == '"' || c == '\\' || c == '\n' || c == '\r' || c == '\t')
+            return 2;
+        return c < 0x20 ? 6 : 1;
+    };
+    std::size_t size = out.size(), extra = 0;
+    for (std::size_t i = start; i < size; ++i)
+        extra += width(static_cast<unsigned char>(out[i])) - 1;
+    if (extra == 0)
+        return;
+    out.resize(size + extra);
+    // 从后往前写，不需要额外的缓冲区
+    char *q = &out[0] + size + extra;
+    for (std::size_t i = size; i-- > start;)
+    {
+        unsigned char c = static_cast<unsigned char>(out[i]);
+        switch (width(c))
+        {
+        case 1:
+            *--q = static_cast<char>(c);
+            break;
+        case 2:
+            *--q = c == '\n' ? 'n' : c == '\r' ? 'r' : c == '\t' ? 't' : static_cast<char>(c);
+            *--q = '\\';
+            break;
+        default:
+            *--q = "0123456789abcdef"[c & 0xF];
+            *--q = "0123456789abcdef"[c >> 4];
+            q -= 4;
+            std::memcpy(q, "\\u00", 4);
+        }
+    }
+}
+
+// 消息部分的开头，结构化格式下消息要加引号
+inline void begin_message(std::string &out, LogRecordFormat format)
+{
+    if (format == LogRecordFormat::Logfmt)
+        out += "msg=\"";
+    else if (format == LogRecordFormat::Json)
+        out += "\"msg\":\"";
+}
+
+// 转义从 `start` 开始的消息并补上引号
+inline void end_message(std::string &out, LogRecordFormat format, std::size_t start)
+{
+    if (format == LogRecordFormat::Text)
+        return;
+    escape_tail(out, start);
+    out += '"';
+}
+
+inline void end_line(std::string &out, LogRecordFormat format)
+{
+    if (format == LogRecordFormat::Json)
+        out += '}';
+    out += '\n';
+}
+
+template <typename T>
+struct is_log_field : std::false_type
+{};
+template <typename T>
+struct is_log_field<LogField<T>> : std::true_type
+{};
+
+// 普通参数写入消息，字段跳过
+template <typename T>
+inline void append_message(std::ostream &os, const T &arg)
+{
+    if constexpr (!is_log_field<T>::value)
+        os << arg;
+}
+
+template <typename T>
+inline void append_value(std::string &out, LogRecordFormat format, const T &value)
+{
+    if constexpr (std::is_same_v<T, bool>)
+    {
+        out += value ? "true" : "false";
+    }
+    else if constexpr (std::is_arithmetic_v<T> && !std::is_same_v<T, char>)
+    {
+        if constexpr (std::is_floating_point_v<T>)
+        {
+            if (format == LogRecordFormat::Json && !std::isfinite(value))
+            {
+                out += "null";
+                return;
+            }
+        }
+        char buf[64];
+        auto result = std::to_chars(buf, buf + sizeof(buf), value);
+        out.append(buf, result.ptr);
+    }
+    else
+    {
+        static_assert(std::is_same_v<T, char> || std::is_convertible_v<const T &, std::string_view>,
+                      "kv value must be arithmetic, bool or string");
+        std::string_view text;
+        if constexpr (std::is_same_v<T, char>)
+            text = std::string_view(&value, 1);
+        else
+            text = value;
+        // logfmt 的字符串只在必要时加引号
+        bool quote = format == LogRecordFormat::Json || text.empty() ||
+                     text.find_first_of(" =\"\\\n\r\t") != std::string_view::npos;
+        if (quote)
+            out += '"';
+        std::size_t start = out.size();
+        out += text;
+        if (quote)
+        {
+            escape_tail(out, start);
+            out += '"';
+        }
+    }
+}
+
+// 字段追加在消息后面，普通参数跳过
+template <typename T>
+inline void append_field(std::string &out, LogRecordFormat format, const T &arg)
+{
+    if constexpr (is_log_field<T>::value)
+    {
+        if (format == LogRecordFormat::Json)
+        {
+            out += ",\"";
+            out += arg.key;
+            out += "\":";
+        }
+        else
+        {
+            if (out.empty() || out.back() != ' ')
+                out += ' ';
+            out += arg.key;
+            out += '=';
+        }
+        append_value(out, format, arg.value);
+    }
+}
+
+// 每个线程缓存时间前缀精确到秒的部分，秒数变化时才重新生成
+struct LogPrefixCache
+{
+    unsigned generation = ~0u;
+    long long second = 0;
+    char text[32];
+    std::size_t size = 0;
+};
+
+} // namespace logger_detail
+
+// 日志前缀的时间格式
+enum class LogTimeFormat
+{
+    Elapsed,     // 距离 init 的时间，[HH:MM:SS]，默认
+    ElapsedMs,   // [HH:MM:SS.mmm]
+    ElapsedUs,   // [HH:MM:SS.uuuuuu]
+    WallClock,   // 本地时间，[YYYY-MM-DD HH:MM:SS]
+    WallClockMs, // [YYYY-MM-DD HH:MM:SS.mmm]
+    WallClockUs  // [YYYY-MM-DD HH:MM:SS.uuuuuu]
+};
+
+// 什么时候把缓冲区写到文件/终端。不管哪种方式，程序退出、`error_stop`和`log_flush`时都会刷新
+enum class LogFlush
+{
+    EveryLine, // 每条日志都刷新（异步模式下每批刷新一次）
+    Interval,  // 距上次刷新超过一定时间才刷新（同步模式下只在写日志时检查，见`LogSink::commit`）
+    OnError,   // 只在遇到 Error 级别的日志时刷新
+    AtExit     // 只在退出时刷新
+};
+
+// 日志的输出目标，Logger 可以同时有多个输出，每个输出有自己的级别和刷新方式。
+// 除了 `AtExit`，Error 级别的日志总是会立即刷新。
+class LogSink
+{
+  public:
+    LogSink(LogLevel level = LogLevel::Verbose, LogFlush flush = LogFlush::EveryLine,
+            std::chrono::milliseconds interval = std::chrono::milliseconds(1000))
+        : m_level(level), m_flush(flush), m_interval(interval), m_last_flush(std::chrono::steady_clock::now())
+    {}
+    virtual ~LogSink() = default;
+
+    // 写入一条完整的日志（包含换行），由 Logger 加锁调用
+    void write(LogLevel level, const char *data, std::size_t size)
+    {
+        if (static_cast<int>(level) > static_cast<int>(m_level))
+            return;
+        do_write(data, size);
+        m_dirty = true;
+        if (m_flush == LogFlush::EveryLine || (level == LogLevel::Error && m_flush != LogFlush::AtExit))
+            m_flush_due = true;
+    }
+
+    // 一批日志写完之后调用，按刷新方式决定是否刷新。
+    // 异步模式下后台线程空闲时也会调用，`Interval`的输出在安静下来之后最多晚 10ms 左右刷新；
+    // 同步模式下没有额外的线程，只在写日志时调用，安静期间最后几条日志会留在缓冲区里，
+    // 直到下一条日志、`log_flush`或者程序退出。
+    void commit()
+    {
+        if (!m_dirty)
+            return;
+        if (m_flush == LogFlush::Interval && std::chrono::steady_clock::now() - m_last_flush >= m_interval)
+            m_flush_due = true;
+        if (m_flush_due)
+            flush();
+    }
+
+    void flush()
+    {
+        do_flush();
+        m_dirty = false;
+        m_flush_due = false;
+        m_last_flush = std::chrono::steady_clock::now();
+    }
+
+  protected:
+    virtual void do_write(const char *data, std::size_t size) = 0;
+    virtual void do_flush() = 0;
+
+  private:
+    LogLevel m_level;
+    LogFlush m_flush;
+    std::chrono::milliseconds m_interval;
+    std::chrono::steady_clock::time_point m_last_flush;
+    bool m_dirty = false;
+    bool m_flush_due = false;
+};
+
+// 输出到 `std::cout` 或者其他流，默认的输出
+class ConsoleSink : public LogSink
+{
+  public:
+    ConsoleSink(std::ostream &os = std::cout, LogLevel level = LogLevel::Verbose,
+                LogFlush flush = LogFlush::EveryLine)
+        : LogSink(level, flush), m_os(os)
+    {}
+
+  protected:
+    void do_write(const char *data, std::size_t size) override { m_os.write(data, size); }
+    void do_flush() override { m_os.flush(); }
+
+  private:
+    std::ostream &m_os;
+};
+
+struct FileSinkOptions
+{
+    LogLevel level = LogLevel::Verbose;
+    LogFlush flush = LogFlush::Interval;
+    std::chrono::milliseconds flush_interval{1000};
+    // 写缓冲区大小
+    std::size_t buffer_size = std::size_t(1) << 20;
+    // 文件超过这个大小就轮转，0 表示不按大小轮转
+    std::size_t rotate_size = 0;
+    // 文件打开超过这个时间就轮转，0 表示不按时间轮转
+    std::chrono::seconds rotate_interval{0};
+    // 轮转后保留的旧文件数，依次命名为 `path.1`, `path.2`, ...，`path.1` 最新
+    std::size_t max_files = 5;
+};
+
+// 带大缓冲区的文件输出，以追加方式打开，支持按大小或者时间轮转
+class FileSink : public LogSink
+{
+  public:
+    FileSink(const std::string &path, const FileSinkOptions &options = FileSinkOptions{})
+        : LogSink(options.level, options.flush, options.flush_interval), m_path(path), m_options(options)
+    {
+        open("ab");
+    }
+    ~FileSink() override
+    {
+        if (m_file != nullptr)
+            std::fclose(m_file);
+    }
+
+    bool good() const { return m_error_msg.empty(); }
+    const std::string &error_msg() const { return m_error_msg; }
+
+  protected:
+    void do_write(const char *data, std::size_t size) override
+    {
+        // 打开失败之后不再写入，也不再轮转，否则每条日志都会把旧文件往后挪一次
+        if (m_file == nullptr)
+            return;
+        if (need_rotate(size))
+            rotate();
+        if (m_file == nullptr)
+            return;
+        std::fwrite(data, 1, size, m_file);
+        m_file_size += size;
+    }
+    void do_flush() override
+    {
+        if (m_file != nullptr)
+            std::fflush(m_file);
+    }
+
+  private:
+    FileSink(const FileSink &) = delete;
+    FileSink &operator=(const FileSink &) = delete;
+
+    void open(const char *mode)
+    {
+        m_file = std::fopen(m_path.c_str(), mode);
+        if (m_file == nullptr)
+        {
+            m_error_msg = "Failed to open log file: " + m_path;
+            m_file_size = 0;
+            return;
+        }
+        m_buffer.resize(m_options.buffer_size);
+        if (!m_buffer.empty())
+            std::setvbuf(m_file, m_buffer.data(), _IOFBF, m_buffer.size());
+        std::fseek(m_file, 0, SEEK_END);
+        long pos = std::ftell(m_file);
+        m_file_size = pos > 0 ? static_cast<std::size_t>(pos) : 0;
+        m_opened = std::chrono::steady_clock::now();
+    }
+
+    bool need_rotate(std::size_t incoming) const
+    {
+        if (m_options.rotate_size != 0 && m_file_size > 0 && m_file_size + incoming > m_options.rotate_size)
+            return true;
+        return m_options.rotate_interval.count() != 0 &&
+               std::chrono::steady_clock::now() - m_opened >= m_options.rotate_interval;
+    }
+
+    void rotate()
+    {
+        if (m_file != nullptr)
+        {
+            std::fclose(m_file);
+            m_file = nullptr;
+        }
+        if (m_options.max_files > 0)
+        {
+            std::remove((m_path + "." + std::to_string(m_options.max_files)).c_str());
+            for (std::size_t i = m_options.max_files - 1; i >= 1; --i)
+            {
+                std::rename((m_path + "." + std::to_string(i)).c_str(),
+                            (m_path + "." + std::to_string(i + 1)).c_str());
+            }
+            std::rename(m_path.c_str(), (m_path + ".1").c_str());
+        }
+        open("wb");
+    }
+
+    std::string m_path;
+    FileSinkOptions m_options;
+    std::FILE *m_file = nullptr;
+    std::vector<char> m_buffer;
+    std::size_t m_file_size = 0;
+    std::chrono::steady_clock::time_point m_opened;
+    std::string m_error_msg;
+};
+
 class Logger
 {
   public:
@@ -29,79 +1010,443 @@ class Logger
         return log;
     }
 
-    void init(LogLevel level)
+    void init(LogLevel level) { reset(level, nullptr); }
+
+    // 异步模式：调用者只把日志放进队列，由后台线程格式化时间并批量输出。
+    // 程序退出或者 `error_stop` 时会把队列中剩余的日志全部输出。
+    void init_async(LogLevel level, std::size_t capacity = 8192, LogFullPolicy policy = LogFullPolicy::Block)
+    {
+        reset(level, std::make_unique<logger_detail::AsyncLogWriter>(
+                         capacity, policy, [this](const logger_detail::LogRecord &rec) { dispatch(rec); },
+                         [this]() { commit_sinks(); }));
+    }
+
+    // 增加一个输出，默认只有一个输出到`std::cout`的 `ConsoleSink`
+    void add_sink(std::shared_ptr<LogSink> sink)
+    {
+        std::lock_guard<std::mutex> lock(m_output_mutex);
+        m_sinks.push_back(std::move(sink));
+    }
+
+    // 去掉所有输出，包括默认的`std::cout`
+    void clear_sinks()
     {
-        m_log_level = level;
-        m_start_time = Logger_clock::now();
+        std::lock_guard<std::mutex> lock(m_output_mutex);
+        for (auto &sink : m_sinks)
+            sink->flush();
+        m_sinks.clear();
+    }
+
+    // 只修改日志级别，可以在任何时候调用
+    void set_level(LogLevel level)
+    {
+        m_log_level.store(static_cast<int>(level), std::memory_order_relaxed);
+        update_capture_level();
+    }
+    LogLevel level() const { return static_cast<LogLevel>(m_log_level.load(std::memory_order_relaxed)); }
+    Logger_clock::time_point start_time() const
+    {
+        return Logger_clock::time_point(Logger_clock::duration(m_start_time.load(std::memory_order_relaxed)));
+    }
+    // 与 `start_time` 同一时刻的单调时钟
+    std::chrono::steady_clock::time_point start_steady_time() const
+    {
+        return std::chrono::steady_clock::time_point(
+            std::chrono::steady_clock::duration(m_start_steady.load(std::memory_order_relaxed)));
+    }
+
+    void set_time_format(LogTimeFormat format)
+    {
+        m_time_format.store(static_cast<int>(format), std::memory_order_relaxed);
+        m_generation.fetch_add(1, std::memory_order_release);
+    }
+    LogTimeFormat time_format() const
+    {
+        return static_cast<LogTimeFormat>(m_time_format.load(std::memory_order_relaxed));
+    }
+
+    // 应在输出日志之前设置，异步模式下修改时已经在队列中的日志可能格式不完整
+    void set_record_format(LogRecordFormat format)
+    {
+        m_record_format.store(static_cast<int>(format), std::memory_order_relaxed);
+    }
+    LogRecordFormat record_format() const
+    {
+        return static_cast<LogRecordFormat>(m_record_format.load(std::memory_order_relaxed));
+    }
+
+    // 异步模式下等待已有的日志全部输出，然后刷新所有输出
+    void flush() const
+    {
+        if (auto writer = m_async.load(std::memory_order_acquire))
+            writer->flush();
+        std::lock_guard<std::mutex> lock(m_output_mutex);
+        for (auto &sink : m_sinks)
+            sink->flush();
+    }
+
+    // 开启飞行记录器，保存最近 `capacity` 条不低于 `level` 的日志（即使该级别不输出），
+    // 在 `error_stop` 以及 SIGSEGV/SIGABRT/SIGTERM/SIGBUS/SIGFPE 时输出到 `file`，`file` 为空则输出到 stderr。
+    void enable_flight_recorder(std::size_t capacity = 4096, LogLevel level = LogLevel::Verbose,
+                                const std::string &file = "", bool install_signal_handlers = true)
+    {
+        std::lock_guard<std::mutex> lock(m_init_mutex);
+        // 旧的记录器可能还在被其他线程使用，不释放
+        logger_detail::flight_recorder.store(new logger_detail::FlightRecorder(capacity, level, file),
+                                             std::memory_order_release);
+        update_capture_level();
+        if (install_signal_handlers)
+        {
+            for (int sig : {SIGSEGV, SIGABRT, SIGTERM, SIGFPE
+#ifdef SIGBUS
+                            ,
+                            SIGBUS
+#endif
+                 })
+            {
+                std::signal(sig, logger_detail::flight_recorder_signal_handler);
+            }
+        }
+    }
+
+    // 手动输出飞行记录器的内容
+    void dump_flight_recorder() const
+    {
+        if (auto recorder = logger_detail::flight_recorder.load(std::memory_order_acquire))
+            recorder->dump();
+    }
+
+    // 运行期该级别是否会被处理（输出或者被飞行记录器记录），用于在构造参数之前判断
+    bool enabled(LogLevel level) const
+    {
+        return static_cast<int>(level) <= m_capture_level.load(std::memory_order_relaxed);
+    }
+
+    // 运行期该级别是否会输出
+    bool outputs(LogLevel level) const
+    {
+        return static_cast<int>(level) <= m_log_level.load(std::memory_order_relaxed);
+    }
+
+    template <LogLevel level, typename... Args>
+    void write(Args &&...args) const
+    {
+        if constexpr (log_compiled<level>)
+        {
+            write_log(level, std::forward<Args>(args)...);
+        }
+    }
+
+    // 延迟格式化：只复制参数的原始值，格式化和时间戳都交给后台线程，适合很紧的循环。
+    // 参数必须是可以直接复制的类型（数值、枚举、指针等），`const char *` 必须指向字符串字面量这种静态存储。
+    // 同步模式下会立即格式化输出。
+    template <LogLevel level, std::size_t N, typename... Args>
+    void write_deferred(const char (&format)[N], Args... args) const
+    {
+        if constexpr (log_compiled<level>)
+        {
+            static_assert((std::is_trivially_copyable_v<Args> && ...),
+                          "deferred log arguments must be trivially copyable");
+            static_assert((sizeof(Args) + ... + 0) <= logger_detail::deferred_capacity,
+                          "deferred log arguments are too large");
+            if (!enabled(level))
+                return;
+            logger_detail::LogRecord rec{level, std::chrono::steady_clock::now(), {}, format,
+                                         &logger_detail::format_deferred<Args...>};
+            unsigned char *p = rec.args;
+            ((std::memcpy(p, &args, sizeof(Args)), p += sizeof(Args)), ...);
+            auto recorder = logger_detail::flight_recorder.load(std::memory_order_acquire);
+            if (recorder != nullptr && recorder->captures(level))
+            {
+                // 飞行记录器需要立即格式化，只有记录器打开了该级别时才有这部分开销
+                auto &tb = logger_detail::thread_buffer();
+                const std::string &text = tb.reset();
+                rec.deferred(tb.os, rec.format, rec.args);
+                auto since = std::chrono::duration_cast<std::chrono::nanoseconds>(rec.time - start_steady_time());
+                recorder->record(level, since.count(), text.data(), text.size());
+            }
+            if (!outputs(level))
+                return;
+            if (auto writer = m_async.load(std::memory_order_acquire))
+            {
+                writer->push(std::move(rec));
+                return;
+            }
+            auto &tb = logger_detail::thread_buffer();
+            std::string &line = tb.reset();
+            auto format = record_format();
+            format_prefix(line, level, rec.time, format);
+            logger_detail::begin_message(line, format);
+            std::size_t start = line.size();
+            rec.deferred(tb.os, rec.format, rec.args);
+            logger_detail::end_message(line, format, start);
+            logger_detail::end_line(line, format);
+            write_line(level, line);
+        }
     }
 
     template <typename... Args>
     void error(Args &&...args) const
     {
-        write_log(LogLevel::Error, std::forward<Args>(args)...);
+        write<LogLevel::Error>(std::forward<Args>(args)...);
     }
 
     template <typename... Args>
     void error_stop(Args &&...args) const
     {
-        write_log(LogLevel::Error, std::forward<Args>(args)...);
+        write<LogLevel::Error>(std::forward<Args>(args)...);
+        flush();
+        dump_flight_recorder();
         std::exit(-1);
     }
 
     template <typename... Args>
     void warn(Args &&...args) const
     {
-        write_log(LogLevel::Warning, std::forward<Args>(args)...);
+        write<LogLevel::Warning>(std::forward<Args>(args)...);
     }
 
     template <typename... Args>
     void info(Args &&...args) const
     {
-        write_log(LogLevel::Info, std::forward<Args>(args)...);
+        write<LogLevel::Info>(std::forward<Args>(args)...);
     }
 
     template <typename... Args>
     void debug(Args &&...args) const
     {
-        write_log(LogLevel::Debug, std::forward<Args>(args)...);
+        write<LogLevel::Debug>(std::forward<Args>(args)...);
     }
 
     template <typename... Args>
     void verbose(Args &&...args) const
     {
-        write_log(LogLevel::Verbose, std::forward<Args>(args)...);
+        write<LogLevel::Verbose>(std::forward<Args>(args)...);
     }
 
   private:
-    LogLevel m_log_level;
-    Logger_clock::time_point m_start_time;
+    std::atomic<int> m_log_level{static_cast<int>(LogLevel::Info)};
+    // 输出级别和飞行记录器级别中较低（数值较大）的那个
+    std::atomic<int> m_capture_level{static_cast<int>(LogLevel::Info)};
+    std::atomic<Logger_clock::rep> m_start_time{Logger_clock::now().time_since_epoch().count()};
+    std::atomic<std::chrono::steady_clock::rep> m_start_steady{
+        std::chrono::steady_clock::now().time_since_epoch().count()};
+    std::atomic<int> m_time_format{static_cast<int>(LogTimeFormat::Elapsed)};
+    std::atomic<int> m_record_format{static_cast<int>(LogRecordFormat::Text)};
+    // init 或者时间格式改变时加一，使各线程缓存的时间前缀失效
+    std::atomic<unsigned> m_generation{0};
+    std::atomic<logger_detail::AsyncLogWriter *> m_async{nullptr};
+    std::vector<std::shared_ptr<LogSink>> m_sinks{std::make_shared<ConsoleSink>()};
+    // 停止后的后台线程对象保留到程序退出，其他线程可能还持有它的指针
+    std::vector<std::unique_ptr<logger_detail::AsyncLogWriter>> m_writers;
+    std::mutex m_init_mutex;
+    mutable std::mutex m_output_mutex;
 
   private:
     Logger() = default;
+    ~Logger()
+    {
+        for (auto &writer : m_writers)
+            writer->stop();
+        flush();
+    }
     Logger(const Logger &) = delete;
     Logger &operator=(const Logger &) = delete;
     Logger(Logger &&) = delete;
     Logger &operator=(Logger &&) = delete;
 
+    void reset(LogLevel level, std::unique_ptr<logger_detail::AsyncLogWriter> writer)
+    {
+        std::lock_guard<std::mutex> lock(m_init_mutex);
+        m_log_level.store(static_cast<int>(level), std::memory_order_relaxed);
+        update_capture_level();
+        m_start_time.store(Logger_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+        m_start_steady.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+        m_generation.fetch_add(1, std::memory_order_release);
+        auto old = m_async.exchange(writer.get(), std::memory_order_acq_rel);
+        if (writer)
+            m_writers.push_back(std::move(writer));
+        if (old)
+            old->stop();
+    }
+
+    void update_capture_level()
+    {
+        int level = m_log_level.load(std::memory_order_relaxed);
+        if (auto recorder = logger_detail::flight_recorder.load(std::memory_order_acquire))
+            level = std::max(level, static_cast<int>(recorder->level()));
+        m_capture_level.store(level, std::memory_order_relaxed);
+    }
+
+    void format_record(std::string &out, const logger_detail::LogRecord &rec) const
+    {
+        auto format = record_format();
+        format_prefix(out, rec.level, rec.time, format);
+        if (rec.deferred != nullptr)
+        {
+            auto &tb = logger_detail::thread_buffer();
+            const std::string &text = tb.reset();
+            rec.deferred(tb.os, rec.format, rec.args);
+            logger_detail::begin_message(out, format);
+            std::size_t start = out.size();
+            out += text;
+            logger_detail::end_message(out, format, start);
+        }
+        else
+        {
+            // 普通日志的消息和字段已经在写入的线程中格式化好了
+            rec.append_message(out);
+        }
+        logger_detail::end_line(out, format);
+    }
+
+    // 同步模式下写入一行并按刷新方式刷新
+    void write_line(LogLevel level, const std::string &line) const
+    {
+        std::lock_guard<std::mutex> lock(m_output_mutex);
+        for (auto &sink : m_sinks)
+        {
+            sink->write(level, line.data(), line.size());
+            sink->commit();
+        }
+    }
+
+    // 异步模式下后台线程逐条调用，一批结束后再调用 `commit_sinks`
+    void dispatch(const logger_detail::LogRecord &rec) const
+    {
+        thread_local std::string line;
+        line.clear();
+        format_record(line, rec);
+        std::lock_guard<std::mutex> lock(m_output_mutex);
+        for (auto &sink : m_sinks)
+            sink->write(rec.level, line.data(), line.size());
+    }
+
+    void commit_sinks() const
+    {
+        std::lock_guard<std::mutex> lock(m_output_mutex);
+        for (auto &sink : m_sinks)
+            sink->commit();
+    }
+
+    void format_prefix(std::string &out, LogLevel level, std::chrono::steady_clock::time_point time,
+                       LogRecordFormat record_format) const
+    {
+        using namespace std::chrono;
+        thread_local logger_detail::LogPrefixCache cache;
+        auto format = time_format();
+        bool wall = format >= LogTimeFormat::WallClock;
+        auto since = duration_cast<nanoseconds>(time - start_steady_time());
+        if (wall)
+            since += duration_cast<nanoseconds>(start_time().time_since_epoch());
+        auto second = floor<seconds>(since);
+        unsigned generation = m_generation.load(std::memory_order_acquire);
+        if (cache.generation != generation || cache.second != second.count())
+        {
+            cache.generation = generation;
+            cache.second = second.count();
+            char *p = cache.text;
+            if (wall)
+            {
+                std::time_t t = static_cast<std::time_t>(second.count());
+                std::tm tm;
+#ifdef _WIN32
+                localtime_s(&tm, &t);
+#else
+                localtime_r(&t, &tm);
+#endif
+                p = logger_detail::append_padded(p, tm.tm_year + 1900, 4);
+                *p++ = '-';
+                p = logger_detail::append_padded(p, tm.tm_mon + 1, 2);
+                *p++ = '-';
+                p = logger_detail::append_padded(p, tm.tm_mday, 2);
+                *p++ = ' ';
+                p = logger_detail::append_padded(p, tm.tm_hour, 2);
+                *p++ = ':';
+                p = logger_detail::append_padded(p, tm.tm_min, 2);
+                *p++ = ':';
+                p = logger_detail::append_padded(p, tm.tm_sec, 2);
+            }
+            else
+            {
+                p = logger_detail::append_padded(p, floor<hours>(second).count() % 24, 2);
+                *p++ = ':';
+                p = logger_detail::append_padded(p, floor<minutes>(second).count() % 60, 2);
+                *p++ = ':';
+                p = logger_detail::append_padded(p, second.count() % 60, 2);
+            }
+            cache.size = p - cache.text;
+        }
+        if (record_format == LogRecordFormat::Text)
+            out += '[';
+        else if (record_format == LogRecordFormat::Logfmt)
+            out += "time=\"";
+        else
+            out += "{\"time\":\"";
+        out.append(cache.text, cache.size);
+        auto sub = (since - second).count();
+        char buf[16];
+        char *p = buf;
+        if (format == LogTimeFormat::ElapsedMs || format == LogTimeFormat::WallClockMs)
+        {
+            *p++ = '.';
+            p = logger_detail::append_padded(p, sub / 1000000, 3);
+        }
+        else if (format == LogTimeFormat::ElapsedUs || format == LogTimeFormat::WallClockUs)
+        {
+            *p++ = '.';
+            p = logger_detail::append_padded(p, sub / 1000, 6);
+        }
+        out.append(buf, p - buf);
+        if (record_format == LogRecordFormat::Text)
+        {
+            out += "] ";
+            return;
+        }
+        out += record_format == LogRecordFormat::Logfmt ? "\" level=" : "\",\"level\":\"";
+        out += logger_detail::level_name(level);
+        out += record_format == LogRecordFormat::Logfmt ? " " : "\",";
+    }
+
+    // 先在本线程的缓冲区中格式化整行，再一次性提交，不同线程的输出不会交错
     template <typename... Args>
     void write_log(LogLevel level, Args &&...args) const
     {
-        if (static_cast<int>(level) > static_cast<int>(m_log_level))
+        if (!enabled(level))
+            return;
+        auto now = std::chrono::steady_clock::now();
+        auto &tb = logger_detail::thread_buffer();
+        std::string &line = tb.reset();
+        bool output = outputs(level);
+        auto writer = output ? m_async.load(std::memory_order_acquire) : nullptr;
+        auto format = record_format();
+        if (output && writer == nullptr)
+            format_prefix(line, level, now, format);
+        std::size_t start = line.size();
+        logger_detail::begin_message(line, format);
+        std::size_t message = line.size();
+        (logger_detail::append_message(tb.os, args), ...);
+        logger_detail::end_message(line, format, message);
+        (logger_detail::append_field(line, format, args), ...);
+        auto recorder = logger_detail::flight_recorder.load(std::memory_order_acquire);
+        if (recorder != nullptr && recorder->captures(level))
+        {
+            auto since = std::chrono::duration_cast<std::chrono::nanoseconds>(now - start_steady_time());
+            recorder->record(level, since.count(), line.data() + start, line.size() - start);
+        }
+        if (!output)
             return;
-        auto now_time = Logger_clock::now();
-        auto dura = now_time - m_start_time;
-        std::ostringstream oss;
-        auto hours = std::chrono::floor<std::chrono::hours>(dura).count() % 24;
-        auto minutes = std::chrono::floor<std::chrono::minutes>(dura).count() % 60;
-        auto seconds = std::chrono::floor<std::chrono::seconds>(dura).count() % 60;
-        oss << std::setfill('0') << '[';
-        oss << std::setw(2) << hours << ':';
-        oss << std::setw(2) << minutes << ':';
-        oss << std::setw(2) << seconds << "] ";
-        oss << std::setfill(' ');
-        (oss << ... << args) << '\n';
-        std::cout << oss.str();
-        std::cout.flush();
+        if (writer != nullptr)
+        {
+            logger_detail::LogRecord rec{};
+            rec.level = level;
+            rec.time = now;
+            rec.set_message(line);
+            writer->push(std::move(rec));
+            return;
+        }
+        logger_detail::end_line(line, format);
+        write_line(level, line);
     }
 };
 
@@ -110,6 +1455,63 @@ inline void log_init(LogLevel level)
     Logger::instance().init(level);
 }
 
+inline void log_init_async(LogLevel level, std::size_t capacity = 8192, LogFullPolicy policy = LogFullPolicy::Block)
+{
+    Logger::instance().init_async(level, capacity, policy);
+}
+
+inline void log_flush()
+{
+    Logger::instance().flush();
+}
+
+// 当前进程的日志文件名，Slurm 作业中为 `dir/prefix.<SLURM_JOB_ID>.<SLURM_PROCID>.log`，否则为 `dir/prefix.<pid>.log`
+inline std::string log_process_filename(const std::string &dir = ".", const std::string &prefix = "log")
+{
+    std::string name = dir.empty() ? prefix : dir + "/" + prefix;
+    const char *job = std::getenv("SLURM_JOB_ID");
+    const char *rank = std::getenv("SLURM_PROCID");
+    if (job != nullptr && rank != nullptr)
+        return name + "." + job + "." + rank + ".log";
+#ifdef _WIN32
+    return name + "." + std::to_string(_getpid()) + ".log";
+#else
+    return name + "." + std::to_string(getpid()) + ".log";
+#endif
+}
+
+// 每个进程把日志写到自己的文件（见 `log_process_filename`），避免多个进程争用同一个 stdout。
+// 时间格式改为 `WallClockUs`，以便之后用 `log_merge` 按时间合并；`console_level` 及以上的日志仍然输出到 stderr。
+// 打不开文件时保留原来的输出，返回 false。
+inline bool log_route_per_process(const std::string &dir = ".", const std::string &prefix = "log",
+                                  const FileSinkOptions &options = FileSinkOptions{},
+                                  LogLevel console_level = LogLevel::Error)
+{
+    auto sink = std::make_shared<FileSink>(log_process_filename(dir, prefix), options);
+    if (!sink->good())
+        return false;
+    auto &logger = Logger::instance();
+    logger.clear_sinks();
+    logger.add_sink(std::move(sink));
+    logger.add_sink(std::make_shared<ConsoleSink>(std::cerr, console_level));
+    logger.set_time_format(LogTimeFormat::WallClockUs);
+    return true;
+}
+
+// 见 `Logger::enable_flight_recorder`
+inline void log_enable_flight_recorder(std::size_t capacity = 4096, LogLevel level = LogLevel::Verbose,
+                                       const std::string &file = "")
+{
+    Logger::instance().enable_flight_recorder(capacity, level, file);
+}
+
+// 例如 `log_deferred<LogLevel::Debug>("iter {} residual {}", iter, res)`
+template <LogLevel level, std::size_t N, typename... Args>
+inline void log_deferred(const char (&format)[N], Args... args)
+{
+    Logger::instance().write_deferred<level>(format, args...);
+}
+
 template <typename... Args>
 inline void log_error(Args &&...args)
 {
@@ -148,4 +1550,59 @@ inline void log_verbose(Args &&...args)
 
 } // end namespace util
 
-#endif // UTIL_LOGGER_HPP
\ No newline at end of file
+// 和 `log_xxx` 函数相同，但是日志被编译期或者运行期的级别过滤掉时，不会对参数求值，
+// 适合参数本身计算代价较大的情况，例如 `UTIL_LOG_DEBUG("x = ", std::to_string(x))`
+#define UTIL_LOG(level, ...)                                                                                           \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if constexpr (::util::log_compiled<level>)                                                                     \
+        {                                                                                                              \
+            if (::util::Logger::instance().enabled(level))                                                             \
+                ::util::Logger::instance().write<level>(__VA_ARGS__);                                                  \
+        }                                                                                                              \
+    } while (0)
+
+#define UTIL_LOG_ERROR(...) UTIL_LOG(::util::LogLevel::Error, __VA_ARGS__)
+#define UTIL_LOG_WARN(...) UTIL_LOG(::util::LogLevel::Warning, __VA_ARGS__)
+#define UTIL_LOG_INFO(...) UTIL_LOG(::util::LogLevel::Info, __VA_ARGS__)
+#define UTIL_LOG_DEBUG(...) UTIL_LOG(::util::LogLevel::Debug, __VA_ARGS__)
+#define UTIL_LOG_VERBOSE(...) UTIL_LOG(::util::LogLevel::Verbose, __VA_ARGS__)
+
+#define UTIL_LOG_WHEN_(level, cond, ...)                                                                               \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if constexpr (::util::log_compiled<level>)                                                                     \
+        {                                                                                                              \
+            if (::util::Logger::instance().enabled(level) && (cond))                                                   \
+                ::util::Logger::instance().write<level>(__VA_ARGS__);                                                  \
+        }                                                                                                              \
+    } while (0)
+
+// 限频日志，每个调用点各自计数，只有级别打开时才计数。例如
+//   UTIL_LOG_EVERY_N(util::LogLevel::Verbose, 1000000, "iter = ", iter);
+#define UTIL_LOG_EVERY_N(level, n, ...)                                                                                \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        static ::util::logger_detail::LogCallSite util_log_site_;                                                      \
+        UTIL_LOG_WHEN_(level, util_log_site_.every_n(n), __VA_ARGS__);                                                \
+    } while (0)
+
+#define UTIL_LOG_FIRST_N(level, n, ...)                                                                                \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        static ::util::logger_detail::LogCallSite util_log_site_;                                                      \
+        UTIL_LOG_WHEN_(level, util_log_site_.first_n(n), __VA_ARGS__);                                                 \
+    } while (0)
+
+// 距离这个调用点上一次输出超过 ms 毫秒才输出
+#define UTIL_LOG_EVERY_MS(level, ms, ...)                                                                              \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        static ::util::logger_detail::LogCallSite util_log_site_;                                                      \
+        UTIL_LOG_WHEN_(level, util_log_site_.every_ms(ms), __VA_ARGS__);                                               \
+    } while (0)
+
+// 随机采样，平均每 n 次输出一次，不需要共享的计数器
+#define UTIL_LOG_SAMPLED(level, n, ...) UTIL_LOG_WHEN_(level, ::util::logger_detail::log_sample(n), __VA_ARGS__)
+
+#endif // UTIL_LOGGER_HPP
@@ -1,12 +1,137 @@
 #include "logger.hpp"
+#include "trace.hpp"
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
 #include <thread>
 
 using namespace util;
 
+namespace
+{
+
+void skip_space(const std::string &s, std::size_t &i)
+{
+    while (i < s.size() && std::isspace(static_cast<unsigned char>(s[i])))
+        ++i;
+}
+
+bool parse_json_string(const std::string &s, std::size_t &i)
+{
+    if (i >= s.size() || s[i] != '"')
+        return false;
+    for (++i; i < s.size(); ++i)
+    {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        if (c == '"')
+        {
+            ++i;
+            return true;
+        }
+        if (c < 0x20)
+            return false;
+        if (c != '\\')
+            continue;
+        if (++i >= s.size())
+            return false;
+        if (s[i] == 'u')
+        {
+            for (int k = 0; k < 4; ++k)
+            {
+                if (++i >= s.size() || !std::isxdigit(static_cast<unsigned char>(s[i])))
+                    return false;
+            }
+        }
+        else if (std::strchr("\"\\/bfnrt", s[i]) == nullptr)
+        {
+            return false;
+        }
+    }
+    return false;
+}
+
+// 检查从 `i` 开始是不是一个合法的 JSON 值，成功时把 `i` 移到值的后面
+bool parse_json(const std::string &s, std::size_t &i)
+{
+    skip_space(s, i);
+    if (i >= s.size())
+        return false;
+    char c = s[i];
+    if (c == '{' || c == '[')
+    {
+        char close = c == '{' ? '}' : ']';
+        skip_space(s, ++i);
+        if (i < s.size() && s[i] == close)
+        {
+            ++i;
+            return true;
+        }
+        for (;;)
+        {
+            if (c == '{')
+            {
+                skip_space(s, i);
+                if (!parse_json_string(s, i))
+                    return false;
+                skip_space(s, i);
+                if (i >= s.size() || s[i++] != ':')
+                    return false;
+            }
+            if (!parse_json(s, i))
+                return false;
+            skip_space(s, i);
+            if (i >= s.size())
+                return false;
+            if (s[i] == close)
+            {
+                ++i;
+                return true;
+            }
+            if (s[i++] != ',')
+                return false;
+        }
+    }
+    if (c == '"')
+        return parse_json_string(s, i);
+    for (const char *word : {"true", "false", "null"})
+    {
+        if (s.compare(i, std::strlen(word), word) == 0)
+        {
+            i += std::strlen(word);
+            return true;
+        }
+    }
+    // 数字：可选的负号，之后必须是数字，只能包含数字、小数点和指数
+    std::size_t start = i;
+    if (s[i] == '-')
+        ++i;
+    if (i >= s.size() || !std::isdigit(static_cast<unsigned char>(s[i])))
+        return false;
+    while (i < s.size() && std::strchr("0123456789.eE+-", s[i]) != nullptr && s[i] != '\0')
+        ++i;
+    return i > start;
+}
+
+bool valid_json(const std::string &line)
+{
+    std::size_t i = 0;
+    if (!parse_json(line, i))
+        return false;
+    skip_space(line, i);
+    return i == line.size();
+}
+
+} // namespace
+
 int main(int argc, char const *argv[])
 {
     std::thread th[10];
     log_init(LogLevel::Info);
+    // Debug 级别不输出，但会留在飞行记录器里，崩溃或者 error_stop 时输出
+    log_enable_flight_recorder(1024, LogLevel::Debug);
+    // 不给文件名时退出时不导出，最后手动导出
+    trace_init("");
     for (int i = 0; i < 10; ++i)
     {
         th[i] = std::thread(
@@ -14,6 +139,7 @@ int main(int argc, char const *argv[])
             {
                 for (int k = 0; k < i; ++k)
                 {
+                    trace_scope scope("sleep");
                     std::this_thread::sleep_for(std::chrono::seconds(1));
                     log_info("Hello, thread ", i);
                 }
@@ -23,5 +149,79 @@ int main(int argc, char const *argv[])
     {
         th[i].join();
     }
+    log_info("sync done", kv("threads", 10), kv("mode", "sync"));
+
+    // 异步模式，日志由后台线程输出，同时写到文件
+    FileSinkOptions options;
+    options.rotate_size = 16 << 10;
+    options.max_files = 2;
+    Logger::instance().add_sink(std::make_shared<FileSink>("test.log", options));
+    log_init_async(LogLevel::Info, 64, LogFullPolicy::Block);
+    for (int i = 0; i < 10; ++i)
+    {
+        th[i] = std::thread(
+            [i]()
+            {
+                for (int k = 0; k < 100; ++k)
+                {
+                    log_info("Hello async, thread ", i, ", record ", k);
+                    log_deferred<LogLevel::Info>("Hello deferred, thread {}, record {}", i, k);
+                    UTIL_LOG_FIRST_N(LogLevel::Info, 2, "first 2 records of all threads: thread ", i);
+                    UTIL_LOG_EVERY_N(LogLevel::Info, 250, "every 250 records of all threads: thread ", i);
+                }
+            });
+    }
+    for (int i = 0; i < 10; ++i)
+    {
+        th[i].join();
+    }
+    UTIL_LOG_DEBUG("filtered, only kept by the flight recorder: ", std::to_string(argc));
+    UTIL_LOG_VERBOSE("filtered, not evaluated: ", std::to_string(argc));
+    log_info("async done");
+    Logger::instance().dump_flight_recorder();
+    trace_dump("test_trace.json");
+
+    // 关闭文件之后删除测试生成的文件
+    log_flush();
+    Logger::instance().clear_sinks();
+    for (const char *filename : {"test.log", "test.log.1", "test.log.2", "test_trace.json"})
+        std::remove(filename);
+
+    // JSON 格式，队列很小并且满了就丢弃，每一行（包括丢弃日志的提示）都必须是合法的 JSON
+    std::ostringstream json;
+    Logger::instance().add_sink(std::make_shared<ConsoleSink>(json));
+    Logger::instance().set_record_format(LogRecordFormat::Json);
+    log_init_async(LogLevel::Info, 16, LogFullPolicy::Drop);
+    for (int i = 0; i < 4; ++i)
+    {
+        th[i] = std::thread(
+            [i]()
+            {
+                for (int k = 0; k < 10000; ++k)
+                    log_info("flood \"", i, "\"\t", kv("k", k), kv("ratio", k / 3.0));
+            });
+    }
+    for (int i = 0; i < 4; ++i)
+    {
+        th[i].join();
+    }
+    log_flush();
+    Logger::instance().clear_sinks();
+    Logger::instance().set_record_format(LogRecordFormat::Text);
+    std::istringstream lines(json.str());
+    std::size_t total = 0, invalid = 0, notices = 0;
+    for (std::string line; std::getline(lines, line); ++total)
+    {
+        if (!valid_json(line))
+        {
+            if (++invalid <= 3)
+                std::cerr << "invalid JSON: " << line << std::endl;
+        }
+        if (line.find("records dropped") != std::string::npos)
+            ++notices;
+    }
+    std::cout << "json: " << total << " lines, " << notices << " drop notices, " << invalid << " invalid" << std::endl;
+    if (invalid > 0 || total == 0)
+        return 1;
     return 0;
 }
@@ -0,0 +1,221 @@
+#pragma once
+#ifndef UTIL_TRACE_HPP
+#define UTIL_TRACE_HPP
+
+#include "logger.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace util
+{
+
+namespace trace_detail
+{
+
+// 时间是 steady_clock 的绝对时间，导出时再减去起点
+struct TraceEvent
+{
+    const char *name;
+    std::int64_t begin_ns;
+    std::int64_t end_ns;
+};
+
+// 每个线程一个，线程结束后由 TraceRegistry 继续持有，直到导出
+struct TraceBuffer
+{
+    int tid;
+    std::mutex mutex;
+    std::vector<TraceEvent> events;
+};
+
+inline void write_json_string(std::ostream &os, const char *s)
+{
+    os << '"';
+    for (; *s; ++s)
+    {
+        unsigned char c = static_cast<unsigned char>(*s);
+        if (c == '"' || c == '\\')
+        {
+            os << '\\' << *s;
+        }
+        else if (c < 0x20)
+        {
+            const char hex[] = "0123456789abcdef";
+            os << "\\u00" << hex[c >> 4] << hex[c & 0xF];
+        }
+        else
+        {
+            os << *s;
+        }
+    }
+    os << '"';
+}
+
+// 非负的纳秒数写成微秒，保留三位小数
+inline void write_us(std::ostream &os, std::int64_t ns)
+{
+    os << ns / 1000 << '.' << std::setw(3) << std::setfill('0') << ns % 1000 << std::setfill(' ');
+}
+
+class TraceRegistry
+{
+  public:
+    static TraceRegistry &instance()
+    {
+        static TraceRegistry registry;
+        return registry;
+    }
+
+    void init(const std::string &filename)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_filename = filename;
+        m_enabled.store(true, std::memory_order_release);
+    }
+
+    bool enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+    TraceBuffer &thread_buffer()
+    {
+        thread_local std::shared_ptr<TraceBuffer> buffer = register_thread();
+        return *buffer;
+    }
+
+    // 导出为 Chrome/Perfetto 的 trace JSON，可以在 chrome://tracing 或者 ui.perfetto.dev 中打开。
+    // 时间从 Logger 的 init 开始计算，和日志的时间戳一致；如果有区间早于 init（在 log_init 之前调用了
+    // trace_init，或者重新 init 过），就从最早的区间开始计算，保证时间不是负数。
+    bool dump(const std::string &filename)
+    {
+        std::ofstream ofs(filename);
+        if (!ofs)
+            return false;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::int64_t origin = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                  Logger::instance().start_steady_time().time_since_epoch())
+                                  .count();
+        for (auto &buffer : m_buffers)
+        {
+            std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+            for (auto &e : buffer->events)
+                origin = std::min(origin, e.begin_ns);
+        }
+#ifdef _WIN32
+        int pid = _getpid();
+#else
+        int pid = getpid();
+#endif
+        ofs << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        for (auto &buffer : m_buffers)
+        {
+            std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+            for (auto &e : buffer->events)
+            {
+                ofs << (first ? "\n" : ",\n") << "{\"ph\":\"X\",\"name\":";
+                write_json_string(ofs, e.name);
+                ofs << ",\"pid\":" << pid << ",\"tid\":" << buffer->tid << ",\"ts\":";
+                write_us(ofs, e.begin_ns - origin);
+                ofs << ",\"dur\":";
+                write_us(ofs, e.end_ns - e.begin_ns);
+                ofs << '}';
+                first = false;
+            }
+        }
+        ofs << "\n]}\n";
+        return static_cast<bool>(ofs);
+    }
+
+  private:
+    TraceRegistry() = default;
+    ~TraceRegistry()
+    {
+        if (enabled() && !m_filename.empty())
+            dump(m_filename);
+    }
+    TraceRegistry(const TraceRegistry &) = delete;
+    TraceRegistry &operator=(const TraceRegistry &) = delete;
+
+    std::shared_ptr<TraceBuffer> register_thread()
+    {
+        auto buffer = std::make_shared<TraceBuffer>();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        buffer->tid = static_cast<int>(m_buffers.size());
+        m_buffers.push_back(buffer);
+        return buffer;
+    }
+
+    std::atomic<bool> m_enabled{false};
+    std::mutex m_mutex;
+    std::string m_filename;
+    std::vector<std::shared_ptr<TraceBuffer>> m_buffers;
+};
+
+inline std::int64_t trace_now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+} // namespace trace_detail
+
+// 开启追踪，程序退出时导出到 `filename`（为空时不导出，只能用 trace_dump）。
+// 时间从 Logger 的 init 开始计算，最好在 log_init 之后调用。
+inline void trace_init(const std::string &filename = "trace.json")
+{
+    // 保证 Logger 先于 TraceRegistry 构造，退出时 TraceRegistry 先析构
+    Logger::instance();
+    trace_detail::TraceRegistry::instance().init(filename);
+}
+
+// 立即导出目前记录的所有区间
+inline bool trace_dump(const std::string &filename)
+{
+    return trace_detail::TraceRegistry::instance().dump(filename);
+}
+
+// 记录一个作用域的开始和结束时间，`name` 必须是字符串字面量这种静态存储。
+// 没有调用 trace_init 时只有一次原子读的开销。
+//   {
+//       util::trace_scope scope("solve");
+//       ...
+//   }
+class trace_scope
+{
+  public:
+    explicit trace_scope(const char *name) : m_name(name)
+    {
+        if (trace_detail::TraceRegistry::instance().enabled())
+        {
+            m_begin = trace_detail::trace_now_ns();
+            m_active = true;
+        }
+    }
+    ~trace_scope()
+    {
+        if (!m_active)
+            return;
+        auto end = trace_detail::trace_now_ns();
+        auto &buffer = trace_detail::TraceRegistry::instance().thread_buffer();
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        buffer.events.push_back(trace_detail::TraceEvent{m_name, m_begin, end});
+    }
+
+  private:
+    trace_scope(const trace_scope &) = delete;
+    trace_scope &operator=(const trace_scope &) = delete;
+
+    const char *m_name;
+    std::int64_t m_begin = 0;
+    bool m_active = false;
+};
+
+} // namespace util
+
+#endif // UTIL_TRACE_HPP
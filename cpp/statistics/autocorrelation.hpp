@@ -0,0 +1,179 @@
+/**
+ * @author: 0.382
+ * @description: blocking analysis and autocorrelation time of Markov chain series
+ * @url: https://github.com/0382/util/tree/main/cpp/statistics
+ */
+
+#pragma once
+#ifndef UTIL_AUTOCORRELATION_HPP
+#define UTIL_AUTOCORRELATION_HPP
+
+#include "statistics.hpp"
+#include <cmath>
+#include <complex>
+#include <vector>
+
+namespace util
+{
+
+// one level of the blocking analysis
+struct blocking_level
+{
+    std::size_t block_size; // number of original data in a block, 2^level
+    std::size_t blocks;     // number of blocks
+    double error;           // standard error of the mean estimated from the block averages
+    double error_of_error;  // statistical uncertainty of `error`
+};
+
+struct autocorrelation_time
+{
+    double tau;         // integrated autocorrelation time, 1 for uncorrelated data
+    double error;       // statistical uncertainty of tau
+    std::size_t window; // number of lags summed
+    double mean_error;  // standard error of the mean, corrected by tau
+
+    friend std::ostream &operator<<(std::ostream &os, const autocorrelation_time &act)
+    {
+        os << "tau = " << act.tau << " +- " << act.error << "\n";
+        os << "window = " << act.window << "\n";
+        os << "mean error = " << act.mean_error << "\n";
+        return os;
+    }
+};
+
+namespace autocorrelation_detail
+{
+
+// in-place iterative radix-2 FFT, `a.size()` must be a power of 2
+inline void fft(std::vector<std::complex<double>> &a, bool inverse)
+{
+    const std::size_t n = a.size();
+    for (std::size_t i = 1, j = 0; i < n; ++i)
+    {
+        std::size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+        if (i < j)
+            std::swap(a[i], a[j]);
+    }
+    // twiddle factors of the largest stage, smaller stages use every (n / len)-th of them
+    constexpr double pi = 3.14159265358979323846;
+    std::vector<std::complex<double>> w(n / 2);
+    for (std::size_t k = 0; k < n / 2; ++k)
+        w[k] = std::polar(1., (inverse ? 2 : -2) * pi * k / n);
+    for (std::size_t len = 2; len <= n; len <<= 1)
+    {
+        std::size_t half = len / 2, stride = n / len;
+        for (std::size_t i = 0; i < n; i += len)
+        {
+            for (std::size_t k = 0; k < half; ++k)
+            {
+                auto u = a[i + k];
+                auto v = a[i + k + half] * w[k * stride];
+                a[i + k] = u + v;
+                a[i + k + half] = u - v;
+            }
+        }
+    }
+}
+
+} // namespace autocorrelation_detail
+
+// blocking(data)
+//   Flyvbjerg-Petersen blocking analysis of correlated data. At level k the data are averaged in blocks of 2^k,
+//   and the standard error of the mean is estimated as if the block averages were independent,
+//   `sqrt(variance(blocks, 1) / blocks)`. The estimate grows with k and reaches a plateau, the true error,
+//   once the blocks are longer than the autocorrelation time; levels with few blocks are noisy, see
+//   `error_of_error`. Each level halves the data, so the whole analysis is O(n).
+template <typename T, typename = typename std::enable_if_t<std::is_arithmetic_v<T>>>
+std::vector<blocking_level> blocking(const std::vector<T> &data)
+{
+    std::vector<blocking_level> levels;
+    std::vector<double> blocked(data.cbegin(), data.cend());
+    for (std::size_t size = 1; blocked.size() >= 2; size *= 2)
+    {
+        double m = static_cast<double>(blocked.size());
+        double error = std::sqrt(variance(blocked, 1) / m);
+        levels.push_back(blocking_level{size, blocked.size(), error, error / std::sqrt(2 * (m - 1))});
+        // an odd last element is dropped
+        for (std::size_t i = 0; i < blocked.size() / 2; ++i)
+            blocked[i] = (blocked[2 * i] + blocked[2 * i + 1]) / 2;
+        blocked.resize(blocked.size() / 2);
+    }
+    return levels;
+}
+
+// autocorrelation(data, max_lag)
+//   normalized autocorrelation function rho(t) = C(t) / C(0) for t = 0, 1, ..., max_lag (default n - 1),
+//   C(t) = sum_{i < n - t} (x_i - mean) (x_{i+t} - mean) / n, C(0) is the variance.
+//   Computed with FFT in O(n log n), using 16 * 2^ceil(log2(n + max_lag)) bytes of memory.
+//   Return an empty vector for empty data, all NaN except rho(0) = 1 if all data are equal.
+template <typename T, typename = typename std::enable_if_t<std::is_arithmetic_v<T>>>
+std::vector<double> autocorrelation(const std::vector<T> &data, std::size_t max_lag = 0)
+{
+    std::size_t n = data.size();
+    if (n == 0)
+    {
+        return {};
+    }
+    max_lag = max_lag == 0 ? n - 1 : std::min(max_lag, n - 1);
+    // zero padding to at least n + max_lag, so that the circular correlation does not wrap around
+    std::size_t size = 1;
+    while (size < n + max_lag)
+        size <<= 1;
+    double xbar = mean(data);
+    std::vector<std::complex<double>> a(size);
+    for (std::size_t i = 0; i < n; ++i)
+        a[i] = static_cast<double>(data[i]) - xbar;
+    autocorrelation_detail::fft(a, false);
+    for (auto &z : a)
+        z = std::norm(z);
+    autocorrelation_detail::fft(a, true);
+    std::vector<double> rho(max_lag + 1);
+    double c0 = a[0].real();
+    for (std::size_t t = 0; t <= max_lag; ++t)
+        rho[t] = a[t].real() / c0;
+    rho[0] = 1;
+    return rho;
+}
+
+// integrated_autocorrelation_time(data, c)
+//   tau = 1 + 2 sum_{t=1}^{W} rho(t), with Sokal's automatic window: the smallest W with W >= c * tau(W).
+//   The variance of the mean of correlated data is tau times larger than for independent data, so
+//   mean_error = sqrt(tau * variance(data, 1) / n), and error = tau * sqrt(2 (2W + 1) / n) (Madras and Sokal).
+//   c = 5 is good for exponential decay, use larger c for slowly decaying rho. The chain should be much longer
+//   than tau (at least about 50 tau), otherwise the estimate is biased low.
+template <typename T, typename = typename std::enable_if_t<std::is_arithmetic_v<T>>>
+autocorrelation_time integrated_autocorrelation_time(const std::vector<T> &data, double c = 5)
+{
+    std::size_t n = data.size();
+    if (n < 2)
+    {
+        return autocorrelation_time{-1, -1, 0, -1};
+    }
+    double var = variance(data, 1);
+    if (!(var > 0))
+    {
+        return autocorrelation_time{1, 0, 0, 0};
+    }
+    auto rho = autocorrelation(data);
+    double tau = 1;
+    std::size_t window = 0;
+    for (std::size_t t = 1; t < rho.size(); ++t)
+    {
+        tau += 2 * rho[t];
+        window = t;
+        if (t >= c * tau)
+        {
+            break;
+        }
+    }
+    // tau < 1 only happens for anticorrelated data or a window too short to be meaningful
+    double error = tau * std::sqrt(2. * (2 * window + 1) / n);
+    return autocorrelation_time{tau, error, window, std::sqrt(std::max(tau, 0.) * var / n)};
+}
+
+} // namespace util
+
+#endif // UTIL_AUTOCORRELATION_HPP
@@ -0,0 +1,362 @@
+/**
+ * @author: 0.382
+ * @description: covariance and correlation matrices of several variables
+ * @url: https://github.com/0382/util/tree/main/cpp/statistics
+ */
+
+#pragma once
+#ifndef UTIL_COVARIANCE_HPP
+#define UTIL_COVARIANCE_HPP
+
+#include "statistics.hpp"
+#include <cmath>
+#include <initializer_list>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace util
+{
+
+// Online accumulator of the means and the covariance matrix of `variables()` variables, each sample is a row
+// of values. Samples are collected into chunks of `chunk_rows` rows, each chunk is centered by its own means and
+// multiplied with itself in cache-sized tiles (a centered GEMM, vectorized with AVX2/AVX-512 when enabled at
+// compile time), then merged into the total with the formula of Chan et al. Accumulators filled by different
+// threads or processes can be combined with `merge`.
+//   covariance_accumulator acc(3);
+//   for (...) acc.push({x, y, z});
+//   acc.covariance(1, 2, 1);
+class covariance_accumulator
+{
+  public:
+    static constexpr std::size_t chunk_rows = 128;
+
+    explicit covariance_accumulator(std::size_t variables)
+        : m_variables(variables), m_stride((variables + 7) / 8 * 8), m_mean(variables, 0),
+          m_comoment(m_stride * m_stride, 0), m_chunk(chunk_rows * m_stride, 0)
+    {
+    }
+
+    std::size_t variables() const { return m_variables; }
+
+    // one sample, the values of all variables
+    template <typename InputIterator>
+    void push(InputIterator first, InputIterator last)
+    {
+        using T = std::remove_cv_t<std::remove_reference_t<decltype(*first)>>;
+        static_assert(std::is_arithmetic_v<T>, "statistics only for arithmetic type");
+        double *row = m_chunk.data() + m_rows * m_stride;
+        std::size_t j = 0;
+        for (; first != last && j < m_variables; ++first, ++j)
+            row[j] = static_cast<double>(*first);
+        if (j != m_variables || first != last)
+        {
+            std::fill(row, row + m_variables, 0.);
+            throw std::invalid_argument("covariance_accumulator: the sample size is not the number of variables");
+        }
+        if (++m_rows == chunk_rows)
+        {
+            flush();
+        }
+    }
+
+    template <typename T, typename = typename std::enable_if_t<std::is_arithmetic_v<T>>>
+    void push(const std::vector<T> &sample)
+    {
+        push(sample.cbegin(), sample.cend());
+    }
+
+    void push(std::initializer_list<double> sample) { push(sample.begin(), sample.end()); }
+
+    // rows [first_row, last_row) of a matrix with `rows()`, `cols()` and `operator()(i, j)`, e.g. `util::Matrix`
+    template <typename Matrix>
+    void push_rows(const Matrix &data, std::size_t first_row, std::size_t last_row)
+    {
+        if (data.cols() != m_variables)
+        {
+            throw std::invalid_argument("covariance_accumulator: the matrix columns are not the number of variables");
+        }
+        for (std::size_t i = first_row; i < last_row; ++i)
+        {
+            double *row = m_chunk.data() + m_rows * m_stride;
+            for (std::size_t j = 0; j < m_variables; ++j)
+                row[j] = static_cast<double>(data(i, j));
+            if (++m_rows == chunk_rows)
+            {
+                flush();
+            }
+        }
+    }
+
+    template <typename Matrix>
+    void push_rows(const Matrix &data)
+    {
+        push_rows(data, 0, data.rows());
+    }
+
+    // combine with the statistics of other samples of the same variables
+    covariance_accumulator &merge(const covariance_accumulator &other)
+    {
+        if (other.m_variables != m_variables)
+        {
+            throw std::invalid_argument("cannot merge covariance_accumulator with different variables");
+        }
+        flush();
+        other.flush();
+        merge_moments(other.m_count, other.m_mean.data(), other.m_comoment.data());
+        return *this;
+    }
+
+    std::int64_t count() const { return m_count + static_cast<std::int64_t>(m_rows); }
+
+    double mean(std::size_t i) const
+    {
+        flush();
+        return m_mean[i];
+    }
+
+    // dof has the same meaning as `util::variance`, return NaN if count <= dof
+    double covariance(std::size_t i, std::size_t j, int dof = 0) const
+    {
+        flush();
+        if (m_count <= dof)
+        {
+            return std::numeric_limits<double>::quiet_NaN();
+        }
+        return comoment(i, j) / static_cast<double>(m_count - dof);
+    }
+
+    // Pearson correlation coefficient, NaN if one of the variables is constant
+    double correlation(std::size_t i, std::size_t j) const
+    {
+        flush();
+        double denominator = std::sqrt(comoment(i, i) * comoment(j, j));
+        if (!(denominator > 0))
+        {
+            return std::numeric_limits<double>::quiet_NaN();
+        }
+        return comoment(i, j) / denominator;
+    }
+
+    // the whole matrices, row-major `variables() * variables()`
+    std::vector<double> covariance(int dof = 0) const
+    {
+        std::vector<double> result(m_variables * m_variables);
+        for (std::size_t i = 0; i < m_variables; ++i)
+        {
+            for (std::size_t j = 0; j < m_variables; ++j)
+                result[i * m_variables + j] = covariance(i, j, dof);
+        }
+        return result;
+    }
+
+    std::vector<double> correlation() const
+    {
+        std::vector<double> result(m_variables * m_variables);
+        for (std::size_t i = 0; i < m_variables; ++i)
+        {
+            for (std::size_t j = 0; j < m_variables; ++j)
+                result[i * m_variables + j] = correlation(i, j);
+        }
+        return result;
+    }
+
+  private:
+    // only the tiles on and above the diagonal are computed
+    double comoment(std::size_t i, std::size_t j) const
+    {
+        return i <= j ? m_comoment[i * m_stride + j] : m_comoment[j * m_stride + i];
+    }
+
+    // c[a][0..8) += sum_k x[k][a] * y[k][0..8) for a = 0..4, `x` and `y` point into the chunk
+    static void tile_kernel(const double *x, const double *y, std::size_t rows, std::size_t stride, double *c)
+    {
+#if defined(__AVX512F__)
+        __m512d acc[4] = {_mm512_setzero_pd(), _mm512_setzero_pd(), _mm512_setzero_pd(), _mm512_setzero_pd()};
+        for (std::size_t k = 0; k < rows; ++k, x += stride, y += stride)
+        {
+            __m512d v = _mm512_loadu_pd(y);
+            for (int a = 0; a < 4; ++a)
+                acc[a] = _mm512_fmadd_pd(_mm512_set1_pd(x[a]), v, acc[a]);
+        }
+        for (int a = 0; a < 4; ++a)
+            _mm512_storeu_pd(c + a * stride, _mm512_add_pd(_mm512_loadu_pd(c + a * stride), acc[a]));
+#elif defined(__AVX2__)
+        __m256d lo[4], hi[4];
+        for (int a = 0; a < 4; ++a)
+            lo[a] = hi[a] = _mm256_setzero_pd();
+        for (std::size_t k = 0; k < rows; ++k, x += stride, y += stride)
+        {
+            __m256d v0 = _mm256_loadu_pd(y), v1 = _mm256_loadu_pd(y + 4);
+            for (int a = 0; a < 4; ++a)
+            {
+                __m256d b = _mm256_set1_pd(x[a]);
+                lo[a] = _mm256_add_pd(lo[a], _mm256_mul_pd(b, v0));
+                hi[a] = _mm256_add_pd(hi[a], _mm256_mul_pd(b, v1));
+            }
+        }
+        for (int a = 0; a < 4; ++a)
+        {
+            _mm256_storeu_pd(c + a * stride, _mm256_add_pd(_mm256_loadu_pd(c + a * stride), lo[a]));
+            _mm256_storeu_pd(c + a * stride + 4, _mm256_add_pd(_mm256_loadu_pd(c + a * stride + 4), hi[a]));
+        }
+#else
+        double acc[4][8] = {};
+        for (std::size_t k = 0; k < rows; ++k, x += stride, y += stride)
+        {
+            for (int a = 0; a < 4; ++a)
+            {
+                for (int b = 0; b < 8; ++b)
+                    acc[a][b] += x[a] * y[b];
+            }
+        }
+        for (int a = 0; a < 4; ++a)
+        {
+            for (int b = 0; b < 8; ++b)
+                c[a * stride + b] += acc[a][b];
+        }
+#endif
+    }
+
+    // C += C_b + (mean_b - mean)(mean_b - mean)^T n n_b / (n + n_b), then update the means,
+    // `comoment_b` is nullptr if C_b has already been added
+    void merge_moments(std::int64_t count_b, const double *mean_b, const double *comoment_b) const
+    {
+        if (count_b == 0)
+        {
+            return;
+        }
+        double n = static_cast<double>(m_count), nb = static_cast<double>(count_b);
+        double total = n + nb;
+        std::vector<double> delta(m_variables);
+        for (std::size_t j = 0; j < m_variables; ++j)
+            delta[j] = mean_b[j] - m_mean[j];
+        double factor = n * nb / total;
+        for (std::size_t i = 0; i < m_variables; ++i)
+        {
+            double *c = m_comoment.data() + i * m_stride;
+            const double *cb = comoment_b ? comoment_b + i * m_stride : nullptr;
+            double di = delta[i] * factor;
+            for (std::size_t j = i; j < m_variables; ++j)
+                c[j] += (comoment_b ? cb[j] : 0) + di * delta[j];
+        }
+        for (std::size_t j = 0; j < m_variables; ++j)
+            m_mean[j] += delta[j] * nb / total;
+        m_count += count_b;
+    }
+
+    // center the buffered rows by their own means and merge their co-moments into the total,
+    // logically const so that the results can be read from a const accumulator
+    void flush() const
+    {
+        if (m_rows == 0)
+        {
+            return;
+        }
+        std::vector<double> chunk_mean(m_stride, 0);
+        for (std::size_t k = 0; k < m_rows; ++k)
+        {
+            const double *row = m_chunk.data() + k * m_stride;
+            for (std::size_t j = 0; j < m_variables; ++j)
+                chunk_mean[j] += row[j];
+        }
+        for (auto &m : chunk_mean)
+            m /= static_cast<double>(m_rows);
+        for (std::size_t k = 0; k < m_rows; ++k)
+        {
+            double *row = m_chunk.data() + k * m_stride;
+            for (std::size_t j = 0; j < m_variables; ++j)
+                row[j] -= chunk_mean[j];
+        }
+        // the co-moments of the chunk are added to the total directly, the padding columns of the chunk are always 0
+        for (std::size_t i = 0; i < m_stride; i += 4)
+        {
+            for (std::size_t j = i / 8 * 8; j < m_stride; j += 8)
+                tile_kernel(m_chunk.data() + i, m_chunk.data() + j, m_rows, m_stride,
+                            m_comoment.data() + i * m_stride + j);
+        }
+        std::int64_t rows = static_cast<std::int64_t>(m_rows);
+        m_rows = 0;
+        merge_moments(rows, chunk_mean.data(), nullptr);
+    }
+
+    std::size_t m_variables;
+    std::size_t m_stride; // variables rounded up to a multiple of 8
+    mutable std::int64_t m_count = 0;
+    mutable std::vector<double> m_mean;
+    mutable std::vector<double> m_comoment; // sum of (x_i - mean_i)(x_j - mean_j), m_stride * m_stride
+    mutable std::vector<double> m_chunk;    // buffered samples, chunk_rows * m_stride
+    mutable std::size_t m_rows = 0;         // number of buffered samples
+};
+
+namespace covariance_detail
+{
+
+template <typename Matrix>
+covariance_accumulator accumulate_rows(const Matrix &data)
+{
+    std::size_t rows = data.rows(), cols = data.cols();
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    std::size_t parts = std::max<std::size_t>(
+        1, std::min<std::size_t>({threads, rows * cols / statistics_detail::parallel_threshold,
+                                  rows / covariance_accumulator::chunk_rows}));
+    auto split = [rows, parts](std::size_t i) { return rows / parts * i + std::min(i, rows % parts); };
+    std::vector<covariance_accumulator> results(parts, covariance_accumulator(cols));
+    std::vector<std::thread> pool;
+    for (std::size_t i = 1; i < parts; ++i)
+        pool.emplace_back([&, i]() { results[i].push_rows(data, split(i), split(i + 1)); });
+    results[0].push_rows(data, 0, split(1));
+    for (auto &th : pool)
+        th.join();
+    for (std::size_t i = 1; i < parts; ++i)
+        results[0].merge(results[i]);
+    return results[0];
+}
+
+template <typename Matrix>
+using has_rows_cols_t = decltype(std::declval<const Matrix &>().rows(), std::declval<const Matrix &>().cols(),
+                                 std::declval<const Matrix &>()(0, 0));
+
+} // namespace covariance_detail
+
+// covariance(data, dof)
+//   covariance matrix of the columns of `data`, each column is a variable and each row a sample.
+//   `data` can be `util::Matrix<T>` or any matrix class template with `rows()`, `cols()`, `operator()(i, j)`
+//   and a constructor `(rows, cols, value)`; the result is a `cols * cols` matrix of double.
+//   dof has the same meaning as `util::variance`, the result is NaN if rows <= dof.
+//   Large data are split by rows across all hardware threads.
+template <template <typename...> class Matrix, typename T, typename... Rest,
+          typename = covariance_detail::has_rows_cols_t<Matrix<T, Rest...>>>
+Matrix<double> covariance(const Matrix<T, Rest...> &data, int dof = 0)
+{
+    auto acc = covariance_detail::accumulate_rows(data);
+    std::size_t p = data.cols();
+    Matrix<double> result(p, p, 0.);
+    for (std::size_t i = 0; i < p; ++i)
+    {
+        for (std::size_t j = 0; j < p; ++j)
+            result(i, j) = acc.covariance(i, j, dof);
+    }
+    return result;
+}
+
+// correlation matrix (Pearson) of the columns of `data`, see `covariance`, NaN for constant columns
+template <template <typename...> class Matrix, typename T, typename... Rest,
+          typename = covariance_detail::has_rows_cols_t<Matrix<T, Rest...>>>
+Matrix<double> correlation(const Matrix<T, Rest...> &data)
+{
+    auto acc = covariance_detail::accumulate_rows(data);
+    std::size_t p = data.cols();
+    Matrix<double> result(p, p, 0.);
+    for (std::size_t i = 0; i < p; ++i)
+    {
+        for (std::size_t j = 0; j < p; ++j)
+            result(i, j) = acc.correlation(i, j);
+    }
+    return result;
+}
+
+} // namespace util
+
+#endif // UTIL_COVARIANCE_HPP
@@ -0,0 +1,303 @@
+/**
+ * @author: 0.382
+ * @description: histogram with fixed-width or variable-edge bins
+ * @url: https://github.com/0382/util/tree/main/cpp/statistics
+ */
+
+#pragma once
+#ifndef UTIL_HISTOGRAM_HPP
+#define UTIL_HISTOGRAM_HPP
+
+#include "statistics.hpp"
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace util
+{
+
+// Histogram of a data stream, with `bins()` fixed-width bins over [lo, hi) or bins between given edges
+// [edges[i], edges[i+1]). Data below the first edge, at or above the last edge, and NaN are counted separately.
+// The bin index is computed without branches: a multiplication for fixed-width bins (vectorized with AVX2/AVX-512
+// when enabled at compile time) and a binary search of fixed length for variable edges.
+// Like `statistics_accumulator`, data can be pushed one by one or as a range, and histograms with the same bins
+// filled by different threads or processes can be combined with `merge`. Contiguous data with more than 2^20
+// elements are split across all hardware threads, each filling its own bins.
+//   histogram h(0., 1., 100);
+//   h.push(data);
+//   for (std::size_t i = 0; i < h.bins(); ++i)
+//       std::cout << h.lower(i) << ' ' << h.upper(i) << ' ' << h[i] << '\n';
+class histogram
+{
+  public:
+    histogram(double lo, double hi, std::size_t bins) : m_uniform(true), m_lo(lo)
+    {
+        if (bins == 0 || !(lo < hi) || !std::isfinite(hi - lo))
+        {
+            throw std::invalid_argument("histogram needs bins > 0 and finite lo < hi");
+        }
+        m_scale = bins / (hi - lo);
+        m_edges.resize(bins + 1);
+        for (std::size_t i = 0; i <= bins; ++i)
+            m_edges[i] = lo + (hi - lo) * i / bins;
+        m_edges.back() = hi;
+        init_bounds();
+    }
+
+    // `edges` must be strictly increasing, with at least two elements
+    explicit histogram(std::vector<double> edges) : m_uniform(false), m_edges(std::move(edges))
+    {
+        if (m_edges.size() < 2 ||
+            std::adjacent_find(m_edges.begin(), m_edges.end(), [](double a, double b) { return !(a < b); }) !=
+                m_edges.end())
+        {
+            throw std::invalid_argument("histogram edges must be strictly increasing");
+        }
+        m_lo = m_edges.front();
+        init_bounds();
+    }
+
+    void push(double x) { ++m_counts[index(x)]; }
+
+    template <typename InputIterator>
+    void push(InputIterator first, InputIterator last)
+    {
+        using T = std::remove_cv_t<std::remove_reference_t<decltype(*first)>>;
+        static_assert(std::is_arithmetic_v<T>, "statistics only for arithmetic type");
+        if constexpr (statistics_detail::is_contiguous_v<InputIterator>)
+        {
+            if (first != last)
+            {
+                push_data(statistics_detail::data_pointer(first), last - first);
+            }
+            return;
+        }
+        for (; first != last; ++first)
+            push(static_cast<double>(*first));
+    }
+
+    template <typename T, typename = typename std::enable_if_t<std::is_arithmetic_v<T>>>
+    void push(const std::vector<T> &data)
+    {
+        push(data.cbegin(), data.cend());
+    }
+
+    // combine with the histogram of another part of the data, the bins must be the same
+    histogram &merge(const histogram &other)
+    {
+        if (other.m_edges != m_edges)
+        {
+            throw std::invalid_argument("cannot merge histograms with different bins");
+        }
+        for (std::size_t i = 0; i < m_counts.size(); ++i)
+            m_counts[i] += other.m_counts[i];
+        return *this;
+    }
+
+    void clear() { std::fill(m_counts.begin(), m_counts.end(), 0); }
+
+    std::size_t bins() const { return m_edges.size() - 1; }
+    bool uniform() const { return m_uniform; }
+    const std::vector<double> &edges() const { return m_edges; }
+    double lower(std::size_t i) const { return m_edges[i]; }
+    double upper(std::size_t i) const { return m_edges[i + 1]; }
+    double center(std::size_t i) const { return (m_edges[i] + m_edges[i + 1]) / 2; }
+
+    // count of the i-th bin
+    std::int64_t operator[](std::size_t i) const { return m_counts[i + 1]; }
+    std::int64_t underflow() const { return m_counts[0]; }
+    std::int64_t overflow() const { return m_counts[bins() + 1]; }
+    std::int64_t nan() const { return m_counts[bins() + 2]; }
+    // all pushed data, including underflow, overflow and NaN
+    std::int64_t count() const { return std::accumulate(m_counts.begin(), m_counts.end(), std::int64_t(0)); }
+
+    // count / (count of data inside the bins) / bin width, so that the density integrates to 1
+    double density(std::size_t i) const
+    {
+        auto inside = std::accumulate(m_counts.begin() + 1, m_counts.begin() + bins() + 1, std::int64_t(0));
+        if (inside == 0)
+        {
+            return 0;
+        }
+        return (*this)[i] / (static_cast<double>(inside) * (upper(i) - lower(i)));
+    }
+
+  private:
+    using counts_t = std::vector<std::int64_t>;
+
+    // m_bounds[i] is the lower bound of m_counts[i], NaN for the last two so that comparisons are always false
+    void init_bounds()
+    {
+        m_bounds.assign(1, -std::numeric_limits<double>::infinity());
+        m_bounds.insert(m_bounds.end(), m_edges.begin(), m_edges.end());
+        m_bounds.resize(m_bounds.size() + 2, std::numeric_limits<double>::quiet_NaN());
+        m_counts.assign(m_edges.size() + 2, 0);
+    }
+
+    // the multiplication may be off by one near the edges because of rounding,
+    // compare with the edges so that x is always in [lower(i), upper(i))
+    std::size_t fix_index(double x, std::size_t i) const
+    {
+        i -= x < m_bounds[i];
+        i += x >= m_bounds[i + 1];
+        return i;
+    }
+
+    // index into m_counts: 0 for underflow, i + 1 for the i-th bin, bins + 1 for overflow, bins + 2 for NaN
+    std::size_t index(double x) const
+    {
+        std::size_t n = bins();
+        std::size_t i;
+        if (m_uniform)
+        {
+            // NaN is clamped to n by the first comparison, fixed below
+            double t = (x - m_lo) * m_scale;
+            t = t < n ? t : n;
+            t = t > -1 ? t : -1;
+            i = fix_index(x, static_cast<std::size_t>(t + 1));
+        }
+        else
+        {
+            // find the last edge <= x, the loop length only depends on the number of edges
+            const double *base = m_edges.data();
+            std::size_t len = m_edges.size();
+            while (len > 1)
+            {
+                std::size_t half = len / 2;
+                base = base[half] <= x ? base + half : base;
+                len -= half;
+            }
+            i = static_cast<std::size_t>(base - m_edges.data()) + (*base <= x);
+        }
+        return x == x ? i : n + 2;
+    }
+
+    // bin indices of a block into `idx`
+    template <typename T>
+    void index_block(const T *p, std::size_t len, std::uint32_t *idx) const
+    {
+        std::size_t i = 0;
+#if defined(__AVX512F__)
+        if constexpr (std::is_same_v<T, double>)
+        {
+            const __m512d lo = _mm512_set1_pd(m_lo), scale = _mm512_set1_pd(m_scale);
+            const __m512d top = _mm512_set1_pd(static_cast<double>(bins()));
+            const __m512d minus_one = _mm512_set1_pd(-1), one = _mm512_set1_pd(1);
+            const __m512d nan_index = _mm512_set1_pd(static_cast<double>(bins() + 2));
+            const __m256i one_i = _mm256_set1_epi32(1);
+            for (; m_uniform && i + 8 <= len; i += 8)
+            {
+                __m512d x = _mm512_loadu_pd(p + i);
+                __m512d t = _mm512_mul_pd(_mm512_sub_pd(x, lo), scale);
+                t = _mm512_max_pd(_mm512_min_pd(t, top), minus_one);
+                // integral before adding one, or t + 1 may round up to the next integer
+                t = _mm512_add_pd(_mm512_roundscale_pd(t, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC), one);
+                t = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(x, x, _CMP_UNORD_Q), t, nan_index);
+                // same as `fix_index`
+                __m256i k = _mm512_cvttpd_epi32(t);
+                __m512d lower = _mm512_i32gather_pd(k, m_bounds.data(), 8);
+                __m512d upper = _mm512_i32gather_pd(_mm256_add_epi32(k, one_i), m_bounds.data(), 8);
+                t = _mm512_mask_sub_pd(t, _mm512_cmp_pd_mask(x, lower, _CMP_LT_OQ), t, one);
+                t = _mm512_mask_add_pd(t, _mm512_cmp_pd_mask(x, upper, _CMP_GE_OQ), t, one);
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(idx + i), _mm512_cvttpd_epi32(t));
+            }
+        }
+#elif defined(__AVX2__)
+        if constexpr (std::is_same_v<T, double>)
+        {
+            const __m256d lo = _mm256_set1_pd(m_lo), scale = _mm256_set1_pd(m_scale);
+            const __m256d top = _mm256_set1_pd(static_cast<double>(bins()));
+            const __m256d minus_one = _mm256_set1_pd(-1), one = _mm256_set1_pd(1);
+            const __m256d nan_index = _mm256_set1_pd(static_cast<double>(bins() + 2));
+            const __m128i one_i = _mm_set1_epi32(1);
+            for (; m_uniform && i + 4 <= len; i += 4)
+            {
+                __m256d x = _mm256_loadu_pd(p + i);
+                __m256d t = _mm256_mul_pd(_mm256_sub_pd(x, lo), scale);
+                t = _mm256_max_pd(_mm256_min_pd(t, top), minus_one);
+                // integral before adding one, or t + 1 may round up to the next integer
+                t = _mm256_add_pd(_mm256_floor_pd(t), one);
+                t = _mm256_blendv_pd(t, nan_index, _mm256_cmp_pd(x, x, _CMP_UNORD_Q));
+                // same as `fix_index`
+                __m128i k = _mm256_cvttpd_epi32(t);
+                __m256d lower = _mm256_i32gather_pd(m_bounds.data(), k, 8);
+                __m256d upper = _mm256_i32gather_pd(m_bounds.data(), _mm_add_epi32(k, one_i), 8);
+                t = _mm256_sub_pd(t, _mm256_and_pd(_mm256_cmp_pd(x, lower, _CMP_LT_OQ), one));
+                t = _mm256_add_pd(t, _mm256_and_pd(_mm256_cmp_pd(x, upper, _CMP_GE_OQ), one));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(idx + i), _mm256_cvttpd_epi32(t));
+            }
+        }
+#endif
+        for (; i < len; ++i)
+            idx[i] = static_cast<std::uint32_t>(index(static_cast<double>(p[i])));
+    }
+
+    // count the data into new bins, with several copies of the bins when they are few, so that
+    // consecutive data in the same bin do not wait for each other's increment
+    template <typename T>
+    counts_t count_kernel(const T *p, std::size_t n) const
+    {
+        constexpr std::size_t copies = 4;
+        const std::size_t size = m_counts.size();
+        const std::size_t used = size <= (std::size_t(1) << 14) ? copies : 1;
+        counts_t counts(size * used, 0);
+        std::uint32_t idx[statistics_detail::block_size];
+        for (std::size_t first = 0; first < n; first += statistics_detail::block_size)
+        {
+            std::size_t len = std::min(statistics_detail::block_size, n - first);
+            index_block(p + first, len, idx);
+            std::size_t i = 0;
+            if (used == copies)
+            {
+                for (; i + copies <= len; i += copies)
+                {
+                    ++counts[idx[i]];
+                    ++counts[size + idx[i + 1]];
+                    ++counts[2 * size + idx[i + 2]];
+                    ++counts[3 * size + idx[i + 3]];
+                }
+            }
+            for (; i < len; ++i)
+                ++counts[idx[i]];
+        }
+        for (std::size_t k = 1; k < used; ++k)
+        {
+            for (std::size_t j = 0; j < size; ++j)
+                counts[j] += counts[k * size + j];
+        }
+        counts.resize(size);
+        return counts;
+    }
+
+    template <typename T>
+    void push_data(const T *p, std::size_t n)
+    {
+        if (bins() + 2 > std::numeric_limits<std::uint32_t>::max())
+        {
+            for (std::size_t i = 0; i < n; ++i)
+                push(static_cast<double>(p[i]));
+            return;
+        }
+        auto counts = statistics_detail::parallel_reduce<counts_t>(
+            n, [this, p](std::size_t first, std::size_t last) { return count_kernel(p + first, last - first); },
+            [](counts_t a, const counts_t &b)
+            {
+                for (std::size_t i = 0; i < a.size(); ++i)
+                    a[i] += b[i];
+                return a;
+            });
+        for (std::size_t i = 0; i < m_counts.size(); ++i)
+            m_counts[i] += counts[i];
+    }
+
+    bool m_uniform;
+    double m_lo;
+    double m_scale = 0;
+    std::vector<double> m_edges;
+    std::vector<double> m_bounds;
+    counts_t m_counts;
+};
+
+} // namespace util
+
+#endif // UTIL_HISTOGRAM_HPP
@@ -0,0 +1,213 @@
+/**
+ * @author: 0.382
+ * @description: bootstrap and jackknife error estimation
+ * @url: https://github.com/0382/util/tree/main/cpp/statistics
+ */
+
+#pragma once
+#ifndef UTIL_RESAMPLE_HPP
+#define UTIL_RESAMPLE_HPP
+
+// random.hpp is in ../random, compile with `-I../random`
+#include "random.hpp"
+#include "statistics.hpp"
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace util
+{
+
+struct resample_result
+{
+    double estimate;                // the statistic of the whole data
+    double bias;                    // estimated bias of `estimate`, subtract it for a bias corrected result
+    double error;                   // standard error of `estimate`
+    std::vector<double> replicates; // the statistic of each resample, e.g. for percentile confidence intervals
+
+    friend std::ostream &operator<<(std::ostream &os, const resample_result &res)
+    {
+        os << "estimate = " << res.estimate << "\n";
+        os << "bias = " << res.bias << "\n";
+        os << "error = " << res.error << "\n";
+        return os;
+    }
+};
+
+namespace resample_detail
+{
+
+// seed of the r-th resample, different resamples get uncorrelated generators (splitmix64 finalizer)
+inline int stream_seed(int seed, std::size_t r)
+{
+    std::uint64_t z = (static_cast<std::uint64_t>(static_cast<std::uint32_t>(seed)) << 32) ^ r;
+    z += 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z ^= z >> 31;
+    return static_cast<int>(static_cast<std::uint32_t>(z));
+}
+
+// call `f(first, last)` on parts of [0, n) in `threads` threads (`threads = 0` for all hardware threads)
+template <typename F>
+void parallel_for(std::size_t n, F f, unsigned threads)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    std::size_t parts = std::max<std::size_t>(1, std::min<std::size_t>(threads, n));
+    auto split = [n, parts](std::size_t i) { return n / parts * i + std::min(i, n % parts); };
+    std::vector<std::thread> pool;
+    for (std::size_t i = 1; i < parts; ++i)
+        pool.emplace_back([&, i]() { f(split(i), split(i + 1)); });
+    f(std::size_t(0), split(1));
+    for (auto &th : pool)
+        th.join();
+}
+
+// mean of the replicates, bias and error of jackknife, `full` is the statistic of all data
+inline resample_result jackknife_result(double full, std::vector<double> replicates)
+{
+    double m = static_cast<double>(replicates.size());
+    double bar = mean(replicates);
+    double var = variance(replicates);
+    return resample_result{full, (m - 1) * (bar - full), std::sqrt((m - 1) * var), std::move(replicates)};
+}
+
+// sums of `bins` contiguous parts of the data, the first `n % bins` parts have one more element
+template <typename T>
+std::vector<double> bin_sums(const std::vector<T> &data, std::size_t bins)
+{
+    std::size_t n = data.size();
+    if (bins == n)
+    {
+        return std::vector<double>(data.cbegin(), data.cend());
+    }
+    std::vector<double> sums(bins);
+    for (std::size_t b = 0; b < bins; ++b)
+    {
+        std::size_t first = n / bins * b + std::min(b, n % bins);
+        std::size_t last = n / bins * (b + 1) + std::min(b + 1, n % bins);
+        sums[b] = static_cast<double>(sum(data.cbegin() + first, data.cbegin() + last));
+    }
+    return sums;
+}
+
+} // namespace resample_detail
+
+// bootstrap(data, statistic, n_resamples, seed, threads)
+//   resample the data with replacement `n_resamples` times and compute `statistic(resample)` for each,
+//   `statistic` is called as `double(const std::vector<T> &)` and must be thread safe.
+//   error is the standard deviation of the replicates and bias is `mean(replicates) - statistic(data)`.
+//   The r-th resample uses its own `util::Random` seeded from (seed, r), so the result only depends on `seed`
+//   and not on the number of threads (`threads = 0` for all hardware threads).
+//   The data size must fit in an int. For correlated data (e.g. Markov chains), bootstrap the bin averages.
+template <typename T, typename F, typename = typename std::enable_if_t<std::is_arithmetic_v<T>>>
+resample_result bootstrap(const std::vector<T> &data, F statistic, std::size_t n_resamples = 1000, int seed = 0,
+                          unsigned threads = 0)
+{
+    if (data.empty() || n_resamples < 2)
+    {
+        throw std::invalid_argument("bootstrap needs non-empty data and at least two resamples");
+    }
+    if (data.size() > static_cast<std::size_t>(std::numeric_limits<int>::max()))
+    {
+        throw std::invalid_argument("bootstrap data size must fit in an int");
+    }
+    double full = statistic(data);
+    std::vector<double> replicates(n_resamples);
+    int last_index = static_cast<int>(data.size()) - 1;
+    resample_detail::parallel_for(
+        n_resamples,
+        [&](std::size_t first, std::size_t last)
+        {
+            std::vector<T> resample(data.size());
+            for (std::size_t r = first; r < last; ++r)
+            {
+                Random<std::mt19937_64> rng(resample_detail::stream_seed(seed, r));
+                for (auto &x : resample)
+                    x = data[rng.randint(0, last_index)];
+                replicates[r] = statistic(static_cast<const std::vector<T> &>(resample));
+            }
+        },
+        threads);
+    double m = mean(replicates);
+    return resample_result{full, m - full, stddev(replicates, 1), std::move(replicates)};
+}
+
+// jackknife(data, f, bins)
+//   jackknife error of `f(mean)`, a function of the mean of the data such as `1 / <x>` or `log <x>`.
+//   The data are divided into `bins` contiguous bins (`bins = 0` for one bin per element), and f is evaluated
+//   at the mean of the data without each bin. These means come from the total sum minus the bin sum,
+//   so the whole analysis is O(n + bins). Use a few hundred bins, each longer than the autocorrelation time,
+//   for correlated data.
+template <typename T, typename F, typename = typename std::enable_if_t<std::is_arithmetic_v<T>>>
+resample_result jackknife(const std::vector<T> &data, F f, std::size_t bins = 0)
+{
+    std::size_t n = data.size();
+    bins = bins == 0 ? n : std::min(bins, n);
+    if (bins < 2)
+    {
+        throw std::invalid_argument("jackknife needs at least two bins");
+    }
+    auto sums = resample_detail::bin_sums(data, bins);
+    double total = sum(sums, summation_policy::pairwise);
+    std::vector<double> replicates(bins);
+    for (std::size_t b = 0; b < bins; ++b)
+    {
+        std::size_t len = n / bins + (b < n % bins);
+        replicates[b] = f((total - sums[b]) / static_cast<double>(n - len));
+    }
+    return resample_detail::jackknife_result(f(total / n), std::move(replicates));
+}
+
+// jackknife(observables, f, bins)
+//   jackknife error of `f(means)`, a function of the means of several observables measured on the same samples,
+//   such as the Binder cumulant `1 - <m^4> / (3 <m^2>^2)`. `observables[k][i]` is the k-th observable of
+//   the i-th sample, all observables must have the same length, and `f` is called as
+//   `double(const std::vector<double> &means)`.
+template <typename T, typename F, typename = typename std::enable_if_t<std::is_arithmetic_v<T>>>
+resample_result jackknife(const std::vector<std::vector<T>> &observables, F f, std::size_t bins = 0)
+{
+    if (observables.empty())
+    {
+        throw std::invalid_argument("jackknife needs at least one observable");
+    }
+    std::size_t n = observables[0].size();
+    for (auto &obs : observables)
+    {
+        if (obs.size() != n)
+        {
+            throw std::invalid_argument("jackknife observables must have the same length");
+        }
+    }
+    bins = bins == 0 ? n : std::min(bins, n);
+    if (bins < 2)
+    {
+        throw std::invalid_argument("jackknife needs at least two bins");
+    }
+    std::size_t k = observables.size();
+    std::vector<std::vector<double>> sums(k);
+    std::vector<double> totals(k), means(k);
+    for (std::size_t j = 0; j < k; ++j)
+    {
+        sums[j] = resample_detail::bin_sums(observables[j], bins);
+        totals[j] = sum(sums[j], summation_policy::pairwise);
+        means[j] = totals[j] / n;
+    }
+    double full = f(static_cast<const std::vector<double> &>(means));
+    std::vector<double> replicates(bins);
+    for (std::size_t b = 0; b < bins; ++b)
+    {
+        std::size_t len = n / bins + (b < n % bins);
+        for (std::size_t j = 0; j < k; ++j)
+            means[j] = (totals[j] - sums[j][b]) / static_cast<double>(n - len);
+        replicates[b] = f(static_cast<const std::vector<double> &>(means));
+    }
+    return resample_detail::jackknife_result(full, std::move(replicates));
+}
+
+} // namespace util
+
+#endif // UTIL_RESAMPLE_HPP
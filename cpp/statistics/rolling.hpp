@@ -0,0 +1,319 @@
+/**
+ * @author: 0.382
+ * @description: statistics over a sliding window of the latest data
+ * @url: https://github.com/0382/util/tree/main/cpp/statistics
+ */
+
+#pragma once
+#ifndef UTIL_ROLLING_HPP
+#define UTIL_ROLLING_HPP
+
+#include "statistics.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace util
+{
+
+namespace rolling_detail
+{
+
+// FIFO ring buffer that can also pop from the back, grows when it is full
+template <typename T>
+class ring
+{
+  public:
+    void reserve(std::size_t capacity)
+    {
+        if (capacity > m_buffer.size())
+        {
+            grow(capacity);
+        }
+    }
+
+    std::size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    const T &front() const { return m_buffer[m_head]; }
+    const T &back() const { return (*this)[m_size - 1]; }
+    const T &operator[](std::size_t i) const
+    {
+        std::size_t k = m_head + i;
+        return m_buffer[k < m_buffer.size() ? k : k - m_buffer.size()];
+    }
+
+    void push_back(const T &x)
+    {
+        if (m_size == m_buffer.size())
+        {
+            grow(std::max<std::size_t>(8, 2 * m_buffer.size()));
+        }
+        std::size_t k = m_head + m_size;
+        m_buffer[k < m_buffer.size() ? k : k - m_buffer.size()] = x;
+        ++m_size;
+    }
+
+    void pop_front()
+    {
+        if (++m_head == m_buffer.size())
+        {
+            m_head = 0;
+        }
+        --m_size;
+    }
+
+    void pop_back() { --m_size; }
+
+    void clear()
+    {
+        m_head = 0;
+        m_size = 0;
+    }
+
+  private:
+    void grow(std::size_t capacity)
+    {
+        std::vector<T> buffer(capacity);
+        for (std::size_t i = 0; i < m_size; ++i)
+            buffer[i] = (*this)[i];
+        m_buffer.swap(buffer);
+        m_head = 0;
+    }
+
+    std::vector<T> m_buffer;
+    std::size_t m_head = 0;
+    std::size_t m_size = 0;
+};
+
+using statistics_detail::moments;
+
+// add one data, the merge of Chan et al. with a single data is Welford's update
+inline moments add(const moments &m, double x)
+{
+    return statistics_detail::merge(m, moments{1, x, 0});
+}
+
+// the data in a sliding window, added at the back and removed from the front.
+// Removing data from running sums loses precision (catastrophic after a large outlier leaves the window), so
+// the moments are kept like a queue of two stacks: the older data have the moments of each suffix, computed
+// when they become the older part, and the newer data have their running moments. Min and max are the fronts
+// of monotonic queues. Every operation is O(1) amortized.
+class window_state
+{
+  public:
+    void reserve(std::size_t capacity)
+    {
+        m_values.reserve(capacity);
+        m_min.reserve(capacity);
+        m_max.reserve(capacity);
+        m_suffix.reserve(capacity);
+    }
+
+    void add(double x)
+    {
+        m_values.push_back(x);
+        m_newer = rolling_detail::add(m_newer, x);
+        // drop the data that can no longer be the min or max while x is in the window
+        while (!m_min.empty() && !(m_min.back().second < x))
+            m_min.pop_back();
+        m_min.push_back({m_added, x});
+        while (!m_max.empty() && !(m_max.back().second > x))
+            m_max.pop_back();
+        m_max.push_back({m_added, x});
+        ++m_added;
+    }
+
+    void remove_oldest()
+    {
+        std::uint64_t oldest = m_added - m_values.size();
+        if (m_older == m_suffix.size())
+        {
+            // all the data become the older part, each is removed once after this, so O(1) amortized
+            m_suffix.resize(m_values.size());
+            moments m;
+            for (std::size_t i = m_values.size(); i-- > 0;)
+            {
+                m = rolling_detail::add(m, m_values[i]);
+                m_suffix[i] = m;
+            }
+            m_older = 0;
+            m_newer = moments{};
+        }
+        ++m_older;
+        m_values.pop_front();
+        if (m_min.front().first == oldest)
+            m_min.pop_front();
+        if (m_max.front().first == oldest)
+            m_max.pop_front();
+    }
+
+    void clear()
+    {
+        m_values.clear();
+        m_min.clear();
+        m_max.clear();
+        m_suffix.clear();
+        m_older = 0;
+        m_newer = moments{};
+    }
+
+    std::size_t count() const { return m_values.size(); }
+    double sum() const { return all().sum; }
+    double mean() const
+    {
+        auto m = all();
+        return m.count == 0 ? 0 : m.sum / m.count;
+    }
+    // sum of squared deviations from the mean
+    double m2() const { return all().m2; }
+    double min() const { return m_min.empty() ? std::numeric_limits<double>::infinity() : m_min.front().second; }
+    double max() const { return m_max.empty() ? -std::numeric_limits<double>::infinity() : m_max.front().second; }
+
+  private:
+    moments all() const
+    {
+        return m_older < m_suffix.size() ? statistics_detail::merge(m_suffix[m_older], m_newer) : m_newer;
+    }
+
+    ring<double> m_values;
+    ring<std::pair<std::uint64_t, double>> m_min; // (index, value), increasing values
+    ring<std::pair<std::uint64_t, double>> m_max; // (index, value), decreasing values
+    std::uint64_t m_added = 0;                   // index of the next data
+    std::vector<moments> m_suffix;                // m_suffix[i] is the moments of the older data from i on
+    std::size_t m_older = 0;                      // the older data still in the window start at m_suffix[m_older]
+    moments m_newer;                              // moments of the newer data
+};
+
+} // namespace rolling_detail
+
+// Mean, variance, min and max of the latest `window()` data, each `push` is O(1) amortized and the results
+// are O(1), instead of O(window) for `util::draft` of the last data. The data are kept in a ring buffer.
+//   rolling_statistics residual(100);
+//   for (...) { residual.push(r); if (residual.full() && residual.max() < tol) break; }
+class rolling_statistics
+{
+  public:
+    explicit rolling_statistics(std::size_t window) : m_window(window)
+    {
+        if (window == 0)
+        {
+            throw std::invalid_argument("rolling_statistics window must be positive");
+        }
+        m_state.reserve(window);
+    }
+
+    void push(double x)
+    {
+        if (m_state.count() == m_window)
+        {
+            m_state.remove_oldest();
+        }
+        m_state.add(x);
+    }
+
+    void clear() { m_state.clear(); }
+
+    std::size_t window() const { return m_window; }
+    bool full() const { return m_state.count() == m_window; }
+    // number of data in the window, less than `window()` at the beginning
+    std::int64_t count() const { return static_cast<std::int64_t>(m_state.count()); }
+    double sum() const { return m_state.sum(); }
+    double mean() const { return m_state.mean(); }
+    // dof has the same meaning as `util::variance`, return -1 if count <= dof
+    double variance(int dof = 0) const
+    {
+        if (count() <= dof)
+        {
+            return -1;
+        }
+        return m_state.m2() / (count() - dof);
+    }
+    double stddev(int dof = 0) const
+    {
+        if (count() <= dof)
+        {
+            return -1;
+        }
+        return std::sqrt(variance(dof));
+    }
+    // minimum and maximum, +inf and -inf for empty window
+    double min() const { return m_state.min(); }
+    double max() const { return m_state.max(); }
+
+  private:
+    std::size_t m_window;
+    rolling_detail::window_state m_state;
+};
+
+// Like `rolling_statistics`, but the window contains the data pushed in the last `window()` time:
+// a data at time t is in the window at time now if `now - t < window`. Time can be a number (e.g. seconds or
+// iteration counts) or a `std::chrono` time point with a duration as the window, and must not decrease.
+//   rolling_time_statistics<std::chrono::steady_clock::time_point> load(std::chrono::seconds(60));
+//   load.push(std::chrono::steady_clock::now(), value);
+template <typename Time = double, typename Duration = decltype(std::declval<Time>() - std::declval<Time>())>
+class rolling_time_statistics
+{
+  public:
+    explicit rolling_time_statistics(Duration window) : m_window(window) {}
+
+    void push(Time t, double x)
+    {
+        advance(t);
+        m_times.push_back(t);
+        m_state.add(x);
+    }
+
+    // remove the data that are out of the window at time `now`, without adding new data
+    void advance(Time now)
+    {
+        while (!m_times.empty() && !(now - m_times.front() < m_window))
+        {
+            m_times.pop_front();
+            m_state.remove_oldest();
+        }
+    }
+
+    void clear()
+    {
+        m_times.clear();
+        m_state.clear();
+    }
+
+    Duration window() const { return m_window; }
+    std::int64_t count() const { return static_cast<std::int64_t>(m_state.count()); }
+    double sum() const { return m_state.sum(); }
+    double mean() const { return m_state.mean(); }
+    // dof has the same meaning as `util::variance`, return -1 if count <= dof
+    double variance(int dof = 0) const
+    {
+        if (count() <= dof)
+        {
+            return -1;
+        }
+        return m_state.m2() / (count() - dof);
+    }
+    double stddev(int dof = 0) const
+    {
+        if (count() <= dof)
+        {
+            return -1;
+        }
+        return std::sqrt(variance(dof));
+    }
+    // minimum and maximum, +inf and -inf for empty window
+    double min() const { return m_state.min(); }
+    double max() const { return m_state.max(); }
+
+  private:
+    Duration m_window;
+    rolling_detail::ring<Time> m_times;
+    rolling_detail::window_state m_state;
+};
+
+} // namespace util
+
+#endif // UTIL_ROLLING_HPP
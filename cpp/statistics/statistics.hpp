@@ -8,12 +8,20 @@
 #ifndef UTIL_STATISTICS_HPP
 #define UTIL_STATISTICS_HPP
 
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <iostream>
+#include <limits>
 #include <numeric>
+#include <thread>
 #include <type_traits>
 #include <vector>
 
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 namespace util
 {
 
@@ -23,6 +31,11 @@ struct statistics_draft
     double mean;
     double variance;
     double stddev;
+    double min;
+    double max;
+    // population skewness and excess kurtosis (0 for normal distribution), NaN if all data are equal
+    double skewness;
+    double kurtosis;
 
     friend std::ostream &operator<<(std::ostream &os, const statistics_draft &dft)
     {
@@ -30,41 +43,711 @@ struct statistics_draft
         os << "mean = " << dft.mean << "\n";
         os << "variance = " << dft.variance << "\n";
         os << "stddev = " << dft.stddev << "\n";
+        os << "min = " << dft.min << "\n";
+        os << "max = " << dft.max << "\n";
+        os << "skewness = " << dft.skewness << "\n";
+        os << "kurtosis = " << dft.kurtosis << "\n";
         return os;
     }
 };
 
+// how sums of floating point data are accumulated, no effect for integer data
+enum class summation_policy
+{
+    naive,    // several independent accumulators, fastest, error grows like n
+    pairwise, // blocks summed naively and combined pairwise, error grows like log(n), almost as fast as naive
+    kahan     // Neumaier compensated summation, error does not grow with n (don't compile with -ffast-math)
+};
+
+namespace statistics_detail
+{
+
+// inputs shorter than this per thread are reduced in the calling thread
+inline constexpr std::size_t parallel_threshold = std::size_t(1) << 20;
+// variance is computed per block while the block is still in cache, then blocks are merged
+inline constexpr std::size_t block_size = 1024;
+
+template <typename InputIterator>
+using value_t = std::remove_cv_t<std::remove_reference_t<decltype(*std::declval<InputIterator>())>>;
+
+// pointers and std::vector iterators can use the fast kernels, except std::vector<bool> which stores bits
+template <typename InputIterator, typename T = value_t<InputIterator>>
+inline constexpr bool is_contiguous_v =
+    std::is_pointer_v<InputIterator> ||
+    (!std::is_same_v<T, bool> && (std::is_same_v<InputIterator, typename std::vector<T>::iterator> ||
+                                  std::is_same_v<InputIterator, typename std::vector<T>::const_iterator>));
+
+// std::vector<T> has `data()` for the fast kernels, otherwise it goes through the iterators
+template <typename T>
+inline constexpr bool has_data_v = is_contiguous_v<typename std::vector<T>::const_iterator, T>;
+
+// `first` must be dereferenceable
+template <typename InputIterator>
+const value_t<InputIterator> *data_pointer(InputIterator first)
+{
+    return &*first;
+}
+
+#if defined(__AVX512F__)
+inline double reduce_add(__m512d a0, __m512d a1, __m512d a2, __m512d a3)
+{
+    return _mm512_reduce_add_pd(_mm512_add_pd(_mm512_add_pd(a0, a1), _mm512_add_pd(a2, a3)));
+}
+#elif defined(__AVX2__)
+inline double reduce_add(__m256d a0, __m256d a1, __m256d a2, __m256d a3)
+{
+    __m256d a = _mm256_add_pd(_mm256_add_pd(a0, a1), _mm256_add_pd(a2, a3));
+    __m128d b = _mm_add_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(b, _mm_unpackhi_pd(b, b)));
+}
+#endif
+
+// sum with several independent accumulators, so that the additions can be pipelined and vectorized
+template <typename Acc, typename T>
+Acc sum_kernel(const T *p, std::size_t n)
+{
+    std::size_t i = 0;
+    Acc total = 0;
+#if defined(__AVX512F__)
+    if constexpr (std::is_same_v<T, double> && std::is_same_v<Acc, double>)
+    {
+        __m512d a0 = _mm512_setzero_pd(), a1 = a0, a2 = a0, a3 = a0;
+        for (; i + 32 <= n; i += 32)
+        {
+            a0 = _mm512_add_pd(a0, _mm512_loadu_pd(p + i));
+            a1 = _mm512_add_pd(a1, _mm512_loadu_pd(p + i + 8));
+            a2 = _mm512_add_pd(a2, _mm512_loadu_pd(p + i + 16));
+            a3 = _mm512_add_pd(a3, _mm512_loadu_pd(p + i + 24));
+        }
+        total = reduce_add(a0, a1, a2, a3);
+    }
+#elif defined(__AVX2__)
+    if constexpr (std::is_same_v<T, double> && std::is_same_v<Acc, double>)
+    {
+        __m256d a0 = _mm256_setzero_pd(), a1 = a0, a2 = a0, a3 = a0;
+        for (; i + 16 <= n; i += 16)
+        {
+            a0 = _mm256_add_pd(a0, _mm256_loadu_pd(p + i));
+            a1 = _mm256_add_pd(a1, _mm256_loadu_pd(p + i + 4));
+            a2 = _mm256_add_pd(a2, _mm256_loadu_pd(p + i + 8));
+            a3 = _mm256_add_pd(a3, _mm256_loadu_pd(p + i + 12));
+        }
+        total = reduce_add(a0, a1, a2, a3);
+    }
+#endif
+    Acc acc[8] = {};
+    for (; i + 8 <= n; i += 8)
+    {
+        for (int k = 0; k < 8; ++k)
+            acc[k] += p[i + k];
+    }
+    for (; i < n; ++i)
+        acc[0] += p[i];
+    return total + (((acc[0] + acc[1]) + (acc[2] + acc[3])) + ((acc[4] + acc[5]) + (acc[6] + acc[7])));
+}
+
+inline constexpr std::size_t pairwise_block = 256;
+
+template <typename Acc, typename T>
+Acc pairwise_sum(const T *p, std::size_t n)
+{
+    if (n <= pairwise_block)
+        return sum_kernel<Acc>(p, n);
+    std::size_t half = n / 2;
+    return pairwise_sum<Acc>(p, half) + pairwise_sum<Acc>(p + half, n - half);
+}
+
+template <typename Acc>
+void neumaier_add(Acc &sum, Acc &comp, Acc x)
+{
+    Acc t = sum + x;
+    if (std::abs(sum) >= std::abs(x))
+        comp += (sum - t) + x;
+    else
+        comp += (x - t) + sum;
+    sum = t;
+}
+
+template <typename Acc>
+void add_lanes(Acc &sum, Acc &comp, const Acc *lane_sum, const Acc *lane_comp, int lanes)
+{
+    for (int k = 0; k < lanes; ++k)
+    {
+        neumaier_add(sum, comp, lane_sum[k]);
+        comp += lane_comp[k];
+    }
+}
+
+// Neumaier summation in independent lanes, the lanes are combined at the end.
+// The compensation terms are summed naively, which is accurate enough in double but not in float,
+// so float sums should use `Acc = double`
+template <typename Acc, typename T>
+Acc kahan_sum(const T *p, std::size_t n)
+{
+    std::size_t i = 0;
+    Acc total = 0, comp = 0;
+#if defined(__AVX512F__)
+    if constexpr (std::is_same_v<T, double> && std::is_same_v<Acc, double>)
+    {
+        __m512d s0 = _mm512_setzero_pd(), s1 = s0, c0 = s0, c1 = s0;
+        auto step = [](__m512d &s, __m512d &c, __m512d x)
+        {
+            __m512d t = _mm512_add_pd(s, x);
+            __mmask8 s_bigger = _mm512_cmp_pd_mask(_mm512_abs_pd(s), _mm512_abs_pd(x), _CMP_GE_OQ);
+            __m512d big = _mm512_mask_blend_pd(s_bigger, x, s);
+            __m512d small = _mm512_mask_blend_pd(s_bigger, s, x);
+            c = _mm512_add_pd(c, _mm512_add_pd(_mm512_sub_pd(big, t), small));
+            s = t;
+        };
+        for (; i + 16 <= n; i += 16)
+        {
+            step(s0, c0, _mm512_loadu_pd(p + i));
+            step(s1, c1, _mm512_loadu_pd(p + i + 8));
+        }
+        double lane_sum[16], lane_comp[16];
+        _mm512_storeu_pd(lane_sum, s0);
+        _mm512_storeu_pd(lane_sum + 8, s1);
+        _mm512_storeu_pd(lane_comp, c0);
+        _mm512_storeu_pd(lane_comp + 8, c1);
+        add_lanes(total, comp, lane_sum, lane_comp, 16);
+    }
+#elif defined(__AVX2__)
+    if constexpr (std::is_same_v<T, double> && std::is_same_v<Acc, double>)
+    {
+        const __m256d sign = _mm256_set1_pd(-0.0);
+        __m256d s0 = _mm256_setzero_pd(), s1 = s0, c0 = s0, c1 = s0;
+        auto step = [sign](__m256d &s, __m256d &c, __m256d x)
+        {
+            __m256d t = _mm256_add_pd(s, x);
+            __m256d s_bigger = _mm256_cmp_pd(_mm256_andnot_pd(sign, s), _mm256_andnot_pd(sign, x), _CMP_GE_OQ);
+            __m256d big = _mm256_blendv_pd(x, s, s_bigger);
+            __m256d small = _mm256_blendv_pd(s, x, s_bigger);
+            c = _mm256_add_pd(c, _mm256_add_pd(_mm256_sub_pd(big, t), small));
+            s = t;
+        };
+        for (; i + 8 <= n; i += 8)
+        {
+            step(s0, c0, _mm256_loadu_pd(p + i));
+            step(s1, c1, _mm256_loadu_pd(p + i + 4));
+        }
+        double lane_sum[8], lane_comp[8];
+        _mm256_storeu_pd(lane_sum, s0);
+        _mm256_storeu_pd(lane_sum + 4, s1);
+        _mm256_storeu_pd(lane_comp, c0);
+        _mm256_storeu_pd(lane_comp + 4, c1);
+        add_lanes(total, comp, lane_sum, lane_comp, 8);
+    }
+#endif
+    // written without branches so that the compiler can vectorize it
+    Acc lane_sum[8] = {}, lane_comp[8] = {};
+    for (; i + 8 <= n; i += 8)
+    {
+        for (int k = 0; k < 8; ++k)
+        {
+            Acc x = p[i + k];
+            Acc t = lane_sum[k] + x;
+            bool s_bigger = std::abs(lane_sum[k]) >= std::abs(x);
+            Acc big = s_bigger ? lane_sum[k] : x;
+            Acc small = s_bigger ? x : lane_sum[k];
+            lane_comp[k] += (big - t) + small;
+            lane_sum[k] = t;
+        }
+    }
+    for (; i < n; ++i)
+        neumaier_add(total, comp, static_cast<Acc>(p[i]));
+    add_lanes(total, comp, lane_sum, lane_comp, 8);
+    return total + comp;
+}
+
+// float is compensated in double, the result is rounded back to float
+template <typename Acc>
+using compensated_t = std::conditional_t<std::is_same_v<Acc, float>, double, Acc>;
+
+template <typename Acc, typename T>
+Acc policy_sum(const T *p, std::size_t n, summation_policy policy)
+{
+    if constexpr (std::is_floating_point_v<Acc>)
+    {
+        if (policy == summation_policy::pairwise)
+            return pairwise_sum<Acc>(p, n);
+        if (policy == summation_policy::kahan)
+            return static_cast<Acc>(kahan_sum<compensated_t<Acc>>(p, n));
+    }
+    return sum_kernel<Acc>(p, n);
+}
+
+// for iterators that are not contiguous, pairwise falls back to kahan
+template <typename Acc, typename InputIterator, typename F>
+Acc iterator_sum(InputIterator first, InputIterator last, summation_policy policy, F f)
+{
+    if (policy == summation_policy::naive || !std::is_floating_point_v<Acc>)
+    {
+        Acc total = 0;
+        for (; first != last; ++first)
+            total += f(*first);
+        return total;
+    }
+    compensated_t<Acc> total = 0, comp = 0;
+    for (; first != last; ++first)
+        neumaier_add(total, comp, static_cast<compensated_t<Acc>>(f(*first)));
+    return static_cast<Acc>(total + comp);
+}
+
+// sum of (x - mean)^2 in double
+template <typename T>
+double sq_dev_kernel(const T *p, std::size_t n, double mean)
+{
+    std::size_t i = 0;
+    double total = 0;
+#if defined(__AVX512F__)
+    if constexpr (std::is_same_v<T, double> || std::is_same_v<T, float>)
+    {
+        __m512d m = _mm512_set1_pd(mean);
+        __m512d a0 = _mm512_setzero_pd(), a1 = a0, a2 = a0, a3 = a0;
+        auto load = [p](std::size_t k)
+        {
+            if constexpr (std::is_same_v<T, double>)
+                return _mm512_loadu_pd(p + k);
+            else
+                return _mm512_cvtps_pd(_mm256_loadu_ps(p + k));
+        };
+        for (; i + 32 <= n; i += 32)
+        {
+            __m512d d0 = _mm512_sub_pd(load(i), m), d1 = _mm512_sub_pd(load(i + 8), m);
+            __m512d d2 = _mm512_sub_pd(load(i + 16), m), d3 = _mm512_sub_pd(load(i + 24), m);
+            a0 = _mm512_fmadd_pd(d0, d0, a0);
+            a1 = _mm512_fmadd_pd(d1, d1, a1);
+            a2 = _mm512_fmadd_pd(d2, d2, a2);
+            a3 = _mm512_fmadd_pd(d3, d3, a3);
+        }
+        total = reduce_add(a0, a1, a2, a3);
+    }
+#elif defined(__AVX2__)
+    if constexpr (std::is_same_v<T, double> || std::is_same_v<T, float>)
+    {
+        __m256d m = _mm256_set1_pd(mean);
+        __m256d a0 = _mm256_setzero_pd(), a1 = a0, a2 = a0, a3 = a0;
+        auto load = [p](std::size_t k)
+        {
+            if constexpr (std::is_same_v<T, double>)
+                return _mm256_loadu_pd(p + k);
+            else
+                return _mm256_cvtps_pd(_mm_loadu_ps(p + k));
+        };
+        for (; i + 16 <= n; i += 16)
+        {
+            __m256d d0 = _mm256_sub_pd(load(i), m), d1 = _mm256_sub_pd(load(i + 4), m);
+            __m256d d2 = _mm256_sub_pd(load(i + 8), m), d3 = _mm256_sub_pd(load(i + 12), m);
+            a0 = _mm256_add_pd(a0, _mm256_mul_pd(d0, d0));
+            a1 = _mm256_add_pd(a1, _mm256_mul_pd(d1, d1));
+            a2 = _mm256_add_pd(a2, _mm256_mul_pd(d2, d2));
+            a3 = _mm256_add_pd(a3, _mm256_mul_pd(d3, d3));
+        }
+        total = reduce_add(a0, a1, a2, a3);
+    }
+#endif
+    double acc[8] = {};
+    for (; i + 8 <= n; i += 8)
+    {
+        for (int k = 0; k < 8; ++k)
+        {
+            double d = p[i + k] - mean;
+            acc[k] += d * d;
+        }
+    }
+    for (; i < n; ++i)
+    {
+        double d = p[i] - mean;
+        acc[0] += d * d;
+    }
+    return total + (((acc[0] + acc[1]) + (acc[2] + acc[3])) + ((acc[4] + acc[5]) + (acc[6] + acc[7])));
+}
+
+// count, sum and sum of squared deviations of part of the data
+struct moments
+{
+    std::size_t count = 0;
+    double sum = 0;
+    double m2 = 0;
+};
+
+// Chan et al. pairwise update
+inline moments merge(const moments &a, const moments &b)
+{
+    if (a.count == 0)
+        return b;
+    if (b.count == 0)
+        return a;
+    double n = static_cast<double>(a.count + b.count);
+    double delta = b.sum / b.count - a.sum / a.count;
+    return moments{a.count + b.count, a.sum + b.sum,
+                   a.m2 + b.m2 + delta * delta * (static_cast<double>(a.count) * b.count / n)};
+}
+
+template <typename T>
+moments block_moments(const T *p, std::size_t n, summation_policy policy)
+{
+    double block_sum = policy == summation_policy::kahan ? kahan_sum<double>(p, n) : sum_kernel<double>(p, n);
+    return moments{n, block_sum, sq_dev_kernel(p, n, block_sum / n)};
+}
+
+// reduce [first, first + n) block by block with `block(first, size)`, which makes two passes over the block
+// while it is in cache, so there is only one pass over memory.
+// With pairwise or kahan policy the blocks are merged pairwise, otherwise one by one
+template <typename M, typename Block>
+M merge_blocks(std::size_t first, std::size_t n, summation_policy policy, Block block)
+{
+    if (policy != summation_policy::naive && n > block_size)
+    {
+        std::size_t half = (n / block_size + 1) / 2 * block_size;
+        return merge(merge_blocks<M>(first, half, policy, block),
+                     merge_blocks<M>(first + half, n - half, policy, block));
+    }
+    M result;
+    for (std::size_t i = 0; i < n; i += block_size)
+        result = merge(result, block(first + i, std::min(block_size, n - i)));
+    return result;
+}
+
+template <typename T>
+moments moments_kernel(const T *p, std::size_t n, summation_policy policy)
+{
+    return merge_blocks<moments>(0, n, policy,
+                                 [p, policy](std::size_t i, std::size_t len)
+                                 { return block_moments(p + i, len, policy); });
+}
+
+// split [0, n) into parts for threads (`threads = 0` for all hardware threads),
+// reduce each part with `f(first, last)` and combine the results in order with `op`
+template <typename R, typename F, typename Op>
+R parallel_reduce(std::size_t n, F f, Op op, unsigned threads = 0)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    std::size_t parts = std::max<std::size_t>(1, std::min<std::size_t>(threads, n / parallel_threshold));
+    if (parts == 1)
+        return f(std::size_t(0), n);
+    auto split = [n, parts](std::size_t i) { return n / parts * i + std::min(i, n % parts); };
+    std::vector<R> results(parts);
+    std::vector<std::thread> pool;
+    for (std::size_t i = 1; i < parts; ++i)
+        pool.emplace_back([&, i]() { results[i] = f(split(i), split(i + 1)); });
+    results[0] = f(std::size_t(0), split(1));
+    for (auto &th : pool)
+        th.join();
+    R result = results[0];
+    for (std::size_t i = 1; i < parts; ++i)
+        result = op(result, results[i]);
+    return result;
+}
+
+template <typename T>
+T sum(const T *p, std::size_t n, summation_policy policy)
+{
+    return parallel_reduce<T>(
+        n, [p, policy](std::size_t first, std::size_t last) { return policy_sum<T>(p + first, last - first, policy); },
+        [](T a, T b) { return a + b; });
+}
+
+template <typename T>
+moments data_moments(const T *p, std::size_t n, summation_policy policy)
+{
+    return parallel_reduce<moments>(
+        n,
+        [p, policy](std::size_t first, std::size_t last) { return moments_kernel(p + first, last - first, policy); },
+        [](const moments &a, const moments &b) { return merge(a, b); });
+}
+
+template <typename T>
+void minmax_kernel(const T *p, std::size_t n, double &lo, double &hi)
+{
+    double lane_lo[8], lane_hi[8];
+    std::fill(lane_lo, lane_lo + 8, std::numeric_limits<double>::infinity());
+    std::fill(lane_hi, lane_hi + 8, -std::numeric_limits<double>::infinity());
+    std::size_t i = 0;
+#if defined(__AVX512F__)
+    if constexpr (std::is_same_v<T, double>)
+    {
+        __m512d l = _mm512_loadu_pd(lane_lo), h = _mm512_loadu_pd(lane_hi);
+        for (; i + 8 <= n; i += 8)
+        {
+            __m512d x = _mm512_loadu_pd(p + i);
+            l = _mm512_min_pd(x, l);
+            h = _mm512_max_pd(x, h);
+        }
+        _mm512_storeu_pd(lane_lo, l);
+        _mm512_storeu_pd(lane_hi, h);
+    }
+#elif defined(__AVX2__)
+    if constexpr (std::is_same_v<T, double>)
+    {
+        __m256d l0 = _mm256_loadu_pd(lane_lo), l1 = l0, h0 = _mm256_loadu_pd(lane_hi), h1 = h0;
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256d x0 = _mm256_loadu_pd(p + i), x1 = _mm256_loadu_pd(p + i + 4);
+            l0 = _mm256_min_pd(x0, l0);
+            l1 = _mm256_min_pd(x1, l1);
+            h0 = _mm256_max_pd(x0, h0);
+            h1 = _mm256_max_pd(x1, h1);
+        }
+        _mm256_storeu_pd(lane_lo, l0);
+        _mm256_storeu_pd(lane_lo + 4, l1);
+        _mm256_storeu_pd(lane_hi, h0);
+        _mm256_storeu_pd(lane_hi + 4, h1);
+    }
+#endif
+    for (; i + 8 <= n; i += 8)
+    {
+        for (int k = 0; k < 8; ++k)
+        {
+            double x = p[i + k];
+            lane_lo[k] = x < lane_lo[k] ? x : lane_lo[k];
+            lane_hi[k] = x > lane_hi[k] ? x : lane_hi[k];
+        }
+    }
+    for (; i < n; ++i)
+    {
+        lane_lo[0] = std::min<double>(lane_lo[0], p[i]);
+        lane_hi[0] = std::max<double>(lane_hi[0], p[i]);
+    }
+    lo = *std::min_element(lane_lo, lane_lo + 8);
+    hi = *std::max_element(lane_hi, lane_hi + 8);
+}
+
+// sums of d^2, d^3 and d^4 with d = x - mean
+template <typename T>
+void power_sums_kernel(const T *p, std::size_t n, double mean, double &s2, double &s3, double &s4)
+{
+    std::size_t i = 0;
+    s2 = s3 = s4 = 0;
+#if defined(__AVX512F__)
+    if constexpr (std::is_same_v<T, double> || std::is_same_v<T, float>)
+    {
+        __m512d m = _mm512_set1_pd(mean);
+        __m512d a2 = _mm512_setzero_pd(), a3 = a2, a4 = a2, b2 = a2, b3 = a2, b4 = a2;
+        auto load = [p](std::size_t k)
+        {
+            if constexpr (std::is_same_v<T, double>)
+                return _mm512_loadu_pd(p + k);
+            else
+                return _mm512_cvtps_pd(_mm256_loadu_ps(p + k));
+        };
+        for (; i + 16 <= n; i += 16)
+        {
+            __m512d d0 = _mm512_sub_pd(load(i), m), d1 = _mm512_sub_pd(load(i + 8), m);
+            __m512d q0 = _mm512_mul_pd(d0, d0), q1 = _mm512_mul_pd(d1, d1);
+            a2 = _mm512_add_pd(a2, q0);
+            a3 = _mm512_fmadd_pd(q0, d0, a3);
+            a4 = _mm512_fmadd_pd(q0, q0, a4);
+            b2 = _mm512_add_pd(b2, q1);
+            b3 = _mm512_fmadd_pd(q1, d1, b3);
+            b4 = _mm512_fmadd_pd(q1, q1, b4);
+        }
+        s2 = _mm512_reduce_add_pd(_mm512_add_pd(a2, b2));
+        s3 = _mm512_reduce_add_pd(_mm512_add_pd(a3, b3));
+        s4 = _mm512_reduce_add_pd(_mm512_add_pd(a4, b4));
+    }
+#elif defined(__AVX2__)
+    if constexpr (std::is_same_v<T, double> || std::is_same_v<T, float>)
+    {
+        __m256d m = _mm256_set1_pd(mean);
+        __m256d a2 = _mm256_setzero_pd(), a3 = a2, a4 = a2, b2 = a2, b3 = a2, b4 = a2;
+        auto load = [p](std::size_t k)
+        {
+            if constexpr (std::is_same_v<T, double>)
+                return _mm256_loadu_pd(p + k);
+            else
+                return _mm256_cvtps_pd(_mm_loadu_ps(p + k));
+        };
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256d d0 = _mm256_sub_pd(load(i), m), d1 = _mm256_sub_pd(load(i + 4), m);
+            __m256d q0 = _mm256_mul_pd(d0, d0), q1 = _mm256_mul_pd(d1, d1);
+            a2 = _mm256_add_pd(a2, q0);
+            a3 = _mm256_add_pd(a3, _mm256_mul_pd(q0, d0));
+            a4 = _mm256_add_pd(a4, _mm256_mul_pd(q0, q0));
+            b2 = _mm256_add_pd(b2, q1);
+            b3 = _mm256_add_pd(b3, _mm256_mul_pd(q1, d1));
+            b4 = _mm256_add_pd(b4, _mm256_mul_pd(q1, q1));
+        }
+        __m256d zero = _mm256_setzero_pd();
+        s2 = reduce_add(a2, b2, zero, zero);
+        s3 = reduce_add(a3, b3, zero, zero);
+        s4 = reduce_add(a4, b4, zero, zero);
+    }
+#endif
+    double l2[8] = {}, l3[8] = {}, l4[8] = {};
+    for (; i + 8 <= n; i += 8)
+    {
+        for (int k = 0; k < 8; ++k)
+        {
+            double d = p[i + k] - mean, q = d * d;
+            l2[k] += q;
+            l3[k] += q * d;
+            l4[k] += q * q;
+        }
+    }
+    for (; i < n; ++i)
+    {
+        double d = p[i] - mean, q = d * d;
+        l2[0] += q;
+        l3[0] += q * d;
+        l4[0] += q * q;
+    }
+    for (int k = 0; k < 8; ++k)
+    {
+        s2 += l2[k];
+        s3 += l3[k];
+        s4 += l4[k];
+    }
+}
+
+// count, sum, min, max and central moments up to the fourth order of part of the data
+struct full_moments
+{
+    std::size_t count = 0;
+    double sum = 0;
+    double mean = 0;
+    double m2 = 0;
+    double m3 = 0;
+    double m4 = 0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+
+    // online update (Welford, Terriberry)
+    void push(double x)
+    {
+        double n1 = static_cast<double>(count);
+        double n = static_cast<double>(++count);
+        double delta = x - mean;
+        double delta_n = delta / n;
+        double delta_n2 = delta_n * delta_n;
+        double term = delta * delta_n * n1;
+        sum += x;
+        mean += delta_n;
+        m4 += term * delta_n2 * (n * n - 3 * n + 3) + 6 * delta_n2 * m2 - 4 * delta_n * m3;
+        m3 += term * delta_n * (n - 2) - 3 * delta_n * m2;
+        m2 += term;
+        min = std::min(min, x);
+        max = std::max(max, x);
+    }
+
+    // dof only affects variance and stddev
+    statistics_draft draft(int dof) const
+    {
+        if (count == 0 || static_cast<std::int64_t>(count) <= dof)
+        {
+            return statistics_draft{-1, -1, -1, -1, -1, -1, -1, -1};
+        }
+        double n = static_cast<double>(count);
+        double var = m2 / (n - dof);
+        double skewness = std::numeric_limits<double>::quiet_NaN(), kurtosis = skewness;
+        if (m2 > 0)
+        {
+            skewness = std::sqrt(n) * m3 / std::pow(m2, 1.5);
+            kurtosis = n * m4 / (m2 * m2) - 3;
+        }
+        return statistics_draft{sum, sum / n, var, std::sqrt(var), min, max, skewness, kurtosis};
+    }
+};
+
+// pairwise update (Chan et al., Pebay)
+inline full_moments merge(const full_moments &a, const full_moments &b)
+{
+    if (a.count == 0)
+        return b;
+    if (b.count == 0)
+        return a;
+    double na = static_cast<double>(a.count), nb = static_cast<double>(b.count), n = na + nb;
+    double delta = b.mean - a.mean;
+    double delta_n = delta / n;
+    full_moments r;
+    r.count = a.count + b.count;
+    r.sum = a.sum + b.sum;
+    r.mean = a.mean + delta_n * nb;
+    r.m2 = a.m2 + b.m2 + delta * delta_n * na * nb;
+    r.m3 = a.m3 + b.m3 + delta * delta_n * delta_n * na * nb * (na - nb) + 3 * delta_n * (na * b.m2 - nb * a.m2);
+    r.m4 = a.m4 + b.m4 + delta * delta_n * delta_n * delta_n * na * nb * (na * na - na * nb + nb * nb) +
+           6 * delta_n * delta_n * (na * na * b.m2 + nb * nb * a.m2) + 4 * delta_n * (na * b.m3 - nb * a.m3);
+    r.min = std::min(a.min, b.min);
+    r.max = std::max(a.max, b.max);
+    return r;
+}
+
+template <typename T>
+full_moments block_full_moments(const T *p, std::size_t n, summation_policy policy)
+{
+    full_moments r;
+    r.count = n;
+    r.sum = policy == summation_policy::kahan ? kahan_sum<double>(p, n) : sum_kernel<double>(p, n);
+    r.mean = r.sum / n;
+    minmax_kernel(p, n, r.min, r.max);
+    power_sums_kernel(p, n, r.mean, r.m2, r.m3, r.m4);
+    return r;
+}
+
+template <typename T>
+full_moments data_full_moments(const T *p, std::size_t n, summation_policy policy)
+{
+    return parallel_reduce<full_moments>(
+        n,
+        [p, policy](std::size_t first, std::size_t last)
+        {
+            return merge_blocks<full_moments>(first, last - first, policy,
+                                              [p, policy](std::size_t i, std::size_t len)
+                                              { return block_full_moments(p + i, len, policy); });
+        },
+        [](const full_moments &a, const full_moments &b) { return merge(a, b); });
+}
+
+} // namespace statistics_detail
+
+// sum, mean, variance, stddev and draft use vectorized kernels (AVX2/AVX-512 when enabled at compile time)
+// and multiple threads for large inputs, if the data is contiguous (std::vector or pointers).
+// Floating point results may differ from a plain left-to-right sum in the last bits.
+// All of them take an optional `summation_policy`, for example `variance(data, 1, summation_policy::kahan)`.
 template <typename T, typename = typename std::enable_if_t<std::is_arithmetic_v<T>>>
-T sum(const std::vector<T> &data)
+T sum(const std::vector<T> &data, summation_policy policy = summation_policy::naive)
 {
-    return std::accumulate(data.cbegin(), data.cend(), static_cast<T>(0));
+    if constexpr (statistics_detail::has_data_v<T>)
+        return statistics_detail::sum(data.data(), data.size(), policy);
+    else
+        return sum(data.cbegin(), data.cend(), policy);
 }
 
 template <typename InputIterator, typename T = std::remove_cv_t<std::remove_reference_t<decltype(*InputIterator())>>,
           typename = typename std::enable_if_t<std::is_arithmetic_v<T>>>
-T sum(InputIterator first, InputIterator last)
+T sum(InputIterator first, InputIterator last, summation_policy policy = summation_policy::naive)
 {
-    return std::accumulate(first, last, static_cast<T>(0));
+    if constexpr (statistics_detail::is_contiguous_v<InputIterator>)
+    {
+        if (first == last)
+        {
+            return 0;
+        }
+        return statistics_detail::sum(statistics_detail::data_pointer(first), last - first, policy);
+    }
+    return statistics_detail::iterator_sum<T>(first, last, policy, [](T x) { return x; });
 }
 
 template <typename T, typename = typename std::enable_if_t<std::is_arithmetic_v<T>>>
-double mean(const std::vector<T> &data)
+double mean(const std::vector<T> &data, summation_policy policy = summation_policy::naive)
 {
     if (data.empty())
     {
         return 0.;
     }
-    return sum(data) / static_cast<double>(data.size());
+    return sum(data, policy) / static_cast<double>(data.size());
 }
 
 template <typename InputIterator>
-double mean(InputIterator first, InputIterator last)
+double mean(InputIterator first, InputIterator last, summation_policy policy = summation_policy::naive)
 {
     if (first == last)
     {
         return 0;
     }
-    return sum(first, last) / static_cast<double>(last - first);
+    return sum(first, last, policy) / static_cast<double>(last - first);
 }
 
 // variance(data, dof)
@@ -73,21 +756,23 @@ double mean(InputIterator first, InputIterator last)
 //     dof: degree of freedom,
 //          for standard variance, use the default dof = 0,
 //          for sample variance, use dof = 1
+//     policy: how to accumulate the sums, see `summation_policy`
 template <typename T, typename = typename std::enable_if_t<std::is_arithmetic_v<T>>>
-double variance(const std::vector<T> &data, int dof = 0)
+double variance(const std::vector<T> &data, int dof = 0, summation_policy policy = summation_policy::naive)
 {
     if (data.empty() || data.size() <= dof)
     {
         return -1;
     }
-    double xbar = mean(data);
-    double addup =
-        std::accumulate(data.cbegin(), data.cend(), 0., [&xbar](double a, T b) { return a + (b - xbar) * (b - xbar); });
-    return addup / (data.size() - dof);
+    if constexpr (statistics_detail::has_data_v<T>)
+        return statistics_detail::data_moments(data.data(), data.size(), policy).m2 / (data.size() - dof);
+    else
+        return variance(data.cbegin(), data.cend(), dof, policy);
 }
 
 template <typename InputIterator>
-double variance(InputIterator first, InputIterator last, int dof = 0)
+double variance(InputIterator first, InputIterator last, int dof = 0,
+                summation_policy policy = summation_policy::naive)
 {
     using T = std::remove_cv_t<std::remove_reference_t<decltype(*first)>>;
     static_assert(std::is_arithmetic_v<T>, "statistics only for arithmetic type");
@@ -95,67 +780,448 @@ double variance(InputIterator first, InputIterator last, int dof = 0)
     {
         return -1;
     }
-    double xbar = mean(first, last);
-    double addup = std::accumulate(first, last, 0., [&xbar](double a, T b) { return a + (b - xbar) * (b - xbar); });
+    if constexpr (statistics_detail::is_contiguous_v<InputIterator>)
+    {
+        if (first != last)
+        {
+            auto m = statistics_detail::data_moments(statistics_detail::data_pointer(first), last - first, policy);
+            return m.m2 / ((last - first) - dof);
+        }
+    }
+    double xbar = mean(first, last, policy);
+    double addup =
+        statistics_detail::iterator_sum<double>(first, last, policy, [xbar](T b) { return (b - xbar) * (b - xbar); });
     return addup / ((last - first) - dof);
 }
 
 // standard deviation, parameters are similar to variance
 template <typename T, typename = typename std::enable_if_t<std::is_arithmetic_v<T>>>
-double stddev(const std::vector<T> &data, int dof = 0)
+double stddev(const std::vector<T> &data, int dof = 0, summation_policy policy = summation_policy::naive)
 {
     if (data.empty() || data.size() <= dof)
     {
         return -1;
     }
-    return std::sqrt(variance(data, dof));
+    return std::sqrt(variance(data, dof, policy));
 }
 
 template <typename InputIterator>
-double stddev(InputIterator first, InputIterator last, int dof = 0)
+double stddev(InputIterator first, InputIterator last, int dof = 0, summation_policy policy = summation_policy::naive)
 {
     if (last - first <= dof)
     {
         return -1;
     }
-    return std::sqrt(variance(first, last, dof));
+    return std::sqrt(variance(first, last, dof, policy));
 }
 
+// sum, mean, variance, stddev, min, max, skewness and kurtosis in a single pass over the data
 template <typename T, typename = typename std::enable_if_t<std::is_arithmetic_v<T>>>
-statistics_draft draft(const std::vector<T> &data, int dof = 0)
+statistics_draft draft(const std::vector<T> &data, int dof = 0, summation_policy policy = summation_policy::naive)
 {
     if (data.empty() || data.size() <= dof)
     {
-        return statistics_draft{-1, -1, -1, -1};
+        return statistics_draft{-1, -1, -1, -1, -1, -1, -1, -1};
     }
-    std::size_t N = data.size();
-    double _sum = sum(data);
-    double _mean = _sum / N;
-    double addup = std::accumulate(data.cbegin(), data.cend(), 0.,
-                                   [&_mean](double a, T b) { return a + (b - _mean) * (b - _mean); });
-    double _var = addup / (N - dof);
-    double _stddev = std::sqrt(_var);
-    return statistics_draft{_sum, _mean, _var, _stddev};
+    if constexpr (statistics_detail::has_data_v<T>)
+        return statistics_detail::data_full_moments(data.data(), data.size(), policy).draft(dof);
+    else
+        return draft(data.cbegin(), data.cend(), dof, policy);
 }
 
+// for iterators that are not contiguous, the data are pushed one by one and `policy` is ignored
 template <typename InputIterator>
-statistics_draft draft(InputIterator first, InputIterator last, int dof = 0)
+statistics_draft draft(InputIterator first, InputIterator last, int dof = 0,
+                       summation_policy policy = summation_policy::naive)
 {
     using T = std::remove_cv_t<std::remove_reference_t<decltype(*first)>>;
     static_assert(std::is_arithmetic_v<T>, "statistics only for arithmetic type");
     if (last - first <= dof)
     {
-        return statistics_draft{-1, -1, -1, -1};
+        return statistics_draft{-1, -1, -1, -1, -1, -1, -1, -1};
+    }
+    if constexpr (statistics_detail::is_contiguous_v<InputIterator>)
+    {
+        return statistics_detail::data_full_moments(statistics_detail::data_pointer(first), last - first, policy)
+            .draft(dof);
+    }
+    statistics_detail::full_moments m;
+    for (; first != last; ++first)
+        m.push(static_cast<double>(*first));
+    return m.draft(dof);
+}
+
+namespace statistics_detail
+{
+
+// linear interpolation between the order statistics x[k] and x[k+1], h = q * (n - 1) (numpy's default),
+// `first` is reordered by std::nth_element
+template <typename T>
+void select_quantiles(T *first, std::size_t n, const std::vector<double> &qs, std::vector<double> &result)
+{
+    result.assign(qs.size(), std::numeric_limits<double>::quiet_NaN());
+    if (n == 0)
+    {
+        return;
+    }
+    // q out of [0, 1] (including NaN) stays NaN, and is left out before sorting: NaN breaks the strict weak
+    // ordering std::sort requires
+    std::vector<std::size_t> order;
+    order.reserve(qs.size());
+    for (std::size_t i = 0; i < qs.size(); ++i)
+    {
+        if (qs[i] >= 0 && qs[i] <= 1)
+            order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(), [&qs](std::size_t a, std::size_t b) { return qs[a] < qs[b]; });
+    // each selection only needs the part after the previous one
+    std::size_t done = 0;
+    for (auto i : order)
+    {
+        double q = qs[i];
+        double h = q * (n - 1);
+        auto k = std::min(static_cast<std::size_t>(h), n - 1);
+        if (k >= done)
+        {
+            std::nth_element(first + done, first + k, first + n);
+            done = k;
+        }
+        double lo = first[k];
+        if (k + 1 < n && h > k)
+        {
+            double hi = *std::min_element(first + k + 1, first + n);
+            result[i] = lo + (h - k) * (hi - lo);
+        }
+        else
+        {
+            result[i] = lo;
+        }
     }
-    int64_t N = last - first;
-    double _sum = sum(first, last);
-    double _mean = _sum / N;
-    double addup = std::accumulate(first, last, 0., [&_mean](double a, T b) { return a + (b - _mean) * (b - _mean); });
-    double _var = addup / (N - dof);
-    double _stddev = std::sqrt(_var);
-    return statistics_draft{_sum, _mean, _var, _stddev};
 }
 
+} // namespace statistics_detail
+
+// quantile(data, q)
+//   exact q-quantile, 0 <= q <= 1, interpolated linearly between the closest order statistics
+//   (the default method of numpy.quantile). The data are copied and partially ordered with std::nth_element,
+//   which is O(n) instead of sorting. Return NaN for empty data or q out of [0, 1].
+//   For several quantiles of the same data, pass them all at once: `quantile(data, {0.5, 0.99, 0.999})`.
+template <typename T, typename = typename std::enable_if_t<std::is_arithmetic_v<T>>>
+std::vector<double> quantile(const std::vector<T> &data, const std::vector<double> &qs)
+{
+    std::vector<T> copy(data);
+    std::vector<double> result;
+    statistics_detail::select_quantiles(copy.data(), copy.size(), qs, result);
+    return result;
+}
+
+template <typename InputIterator>
+std::vector<double> quantile(InputIterator first, InputIterator last, const std::vector<double> &qs)
+{
+    using T = std::remove_cv_t<std::remove_reference_t<decltype(*first)>>;
+    static_assert(std::is_arithmetic_v<T>, "statistics only for arithmetic type");
+    std::vector<T> copy(first, last);
+    std::vector<double> result;
+    statistics_detail::select_quantiles(copy.data(), copy.size(), qs, result);
+    return result;
+}
+
+template <typename T, typename = typename std::enable_if_t<std::is_arithmetic_v<T>>>
+double quantile(const std::vector<T> &data, double q)
+{
+    return quantile(data, std::vector<double>{q})[0];
+}
+
+template <typename InputIterator>
+double quantile(InputIterator first, InputIterator last, double q)
+{
+    return quantile(first, last, std::vector<double>{q})[0];
+}
+
+template <typename T, typename = typename std::enable_if_t<std::is_arithmetic_v<T>>>
+double median(const std::vector<T> &data)
+{
+    return quantile(data, 0.5);
+}
+
+template <typename InputIterator>
+double median(InputIterator first, InputIterator last)
+{
+    return quantile(first, last, 0.5);
+}
+
+// Online accumulator of count, mean, min, max and central moments up to the fourth order,
+// so the data never need to be kept in memory. Accumulators filled by different threads or processes
+// can be combined with `merge`, which uses the pairwise formulas of Chan et al. and Pebay.
+//   statistics_accumulator acc;
+//   for (...) acc.push(x);
+//   acc.variance(1);
+class statistics_accumulator
+{
+  public:
+    void push(double x) { m_moments.push(x); }
+
+    template <typename InputIterator>
+    void push(InputIterator first, InputIterator last)
+    {
+        using T = std::remove_cv_t<std::remove_reference_t<decltype(*first)>>;
+        static_assert(std::is_arithmetic_v<T>, "statistics only for arithmetic type");
+        for (; first != last; ++first)
+            push(static_cast<double>(*first));
+    }
+
+    template <typename T, typename = typename std::enable_if_t<std::is_arithmetic_v<T>>>
+    void push(const std::vector<T> &data)
+    {
+        push(data.cbegin(), data.cend());
+    }
+
+    // combine with the statistics of another part of the data
+    statistics_accumulator &merge(const statistics_accumulator &other)
+    {
+        m_moments = statistics_detail::merge(m_moments, other.m_moments);
+        return *this;
+    }
+
+    std::int64_t count() const { return static_cast<std::int64_t>(m_moments.count); }
+    double sum() const { return m_moments.sum; }
+    double mean() const { return m_moments.mean; }
+    // minimum and maximum, +inf and -inf for empty data
+    double min() const { return m_moments.min; }
+    double max() const { return m_moments.max; }
+
+    // dof has the same meaning as `util::variance`, return -1 if count <= dof
+    double variance(int dof = 0) const
+    {
+        if (count() <= dof)
+        {
+            return -1;
+        }
+        return m_moments.m2 / (count() - dof);
+    }
+
+    double stddev(int dof = 0) const
+    {
+        if (count() <= dof)
+        {
+            return -1;
+        }
+        return std::sqrt(variance(dof));
+    }
+
+    // skewness, kurtosis and the other fields are defined as in `statistics_draft`
+    statistics_draft draft(int dof = 0) const { return m_moments.draft(dof); }
+
+  private:
+    statistics_detail::full_moments m_moments;
+};
+
+
+// Streaming quantile estimation with a merging t-digest (Dunning & Ertl), for data too large to keep.
+// The memory is bounded by `compression` (about 2 * compression centroids plus a buffer), independent of the
+// number of data. Centroids near q = 0 and q = 1 are kept small, so the error in rank (|q_estimated - q|) is
+// about 2e-4 near the median and shrinks towards the tails (below 1e-4 at p99.9) for the default compression.
+// Sketches filled by different threads or processes can be combined with `merge`.
+//   quantile_sketch sketch;
+//   for (...) sketch.push(latency);
+//   sketch.quantile(0.99);
+class quantile_sketch
+{
+  public:
+    explicit quantile_sketch(double compression = 200) : m_compression(std::max(compression, 10.))
+    {
+        m_buffer.reserve(buffer_capacity());
+    }
+
+    void push(double x) { push(x, 1); }
+
+    template <typename InputIterator>
+    void push(InputIterator first, InputIterator last)
+    {
+        using T = std::remove_cv_t<std::remove_reference_t<decltype(*first)>>;
+        static_assert(std::is_arithmetic_v<T>, "statistics only for arithmetic type");
+        for (; first != last; ++first)
+            push(static_cast<double>(*first));
+    }
+
+    template <typename T, typename = typename std::enable_if_t<std::is_arithmetic_v<T>>>
+    void push(const std::vector<T> &data)
+    {
+        push(data.cbegin(), data.cend());
+    }
+
+    // combine with the sketch of another part of the data
+    quantile_sketch &merge(const quantile_sketch &other)
+    {
+        other.compress();
+        auto centroids = other.m_centroids; // `other` may be *this
+        for (auto &c : centroids)
+            push(c.mean, c.weight);
+        m_min = std::min(m_min, other.m_min);
+        m_max = std::max(m_max, other.m_max);
+        return *this;
+    }
+
+    std::int64_t count() const { return static_cast<std::int64_t>(m_count); }
+    // minimum and maximum are exact, +inf and -inf for empty data
+    double min() const { return m_min; }
+    double max() const { return m_max; }
+    // number of centroids after compression, for checking the memory usage
+    std::size_t size() const
+    {
+        compress();
+        return m_centroids.size();
+    }
+
+    // estimated q-quantile, 0 <= q <= 1, NaN for empty data or q out of [0, 1]
+    double quantile(double q) const
+    {
+        compress();
+        if (m_centroids.empty() || !(q >= 0 && q <= 1))
+        {
+            return std::numeric_limits<double>::quiet_NaN();
+        }
+        const auto &c = m_centroids;
+        double index = q * m_count;
+        if (index < 1)
+        {
+            return m_min;
+        }
+        if (index > m_count - 1)
+        {
+            return m_max;
+        }
+        // the first and last half centroids are interpolated to the exact min and max
+        if (c.front().weight > 1 && index < c.front().weight / 2)
+        {
+            return m_min + (index - 1) / (c.front().weight / 2 - 1) * (c.front().mean - m_min);
+        }
+        if (c.back().weight > 1 && m_count - index < c.back().weight / 2)
+        {
+            return m_max - (m_count - index - 1) / (c.back().weight / 2 - 1) * (m_max - c.back().mean);
+        }
+        // between the centers of two neighbouring centroids, a centroid of weight 1 is an exact data point
+        double left = c.front().weight / 2;
+        for (std::size_t i = 0; i + 1 < c.size(); ++i)
+        {
+            double dw = (c[i].weight + c[i + 1].weight) / 2;
+            if (left + dw > index)
+            {
+                double left_unit = 0, right_unit = 0;
+                if (c[i].weight == 1)
+                {
+                    if (index - left < 0.5)
+                    {
+                        return c[i].mean;
+                    }
+                    left_unit = 0.5;
+                }
+                if (c[i + 1].weight == 1)
+                {
+                    if (left + dw - index <= 0.5)
+                    {
+                        return c[i + 1].mean;
+                    }
+                    right_unit = 0.5;
+                }
+                double z1 = index - left - left_unit;
+                double z2 = left + dw - index - right_unit;
+                return (c[i].mean * z2 + c[i + 1].mean * z1) / (z1 + z2);
+            }
+            left += dw;
+        }
+        return c.back().mean;
+    }
+
+    std::vector<double> quantile(const std::vector<double> &qs) const
+    {
+        std::vector<double> result(qs.size());
+        for (std::size_t i = 0; i < qs.size(); ++i)
+            result[i] = quantile(qs[i]);
+        return result;
+    }
+
+    double median() const { return quantile(0.5); }
+
+  private:
+    struct centroid
+    {
+        double mean;
+        double weight;
+    };
+
+    std::size_t buffer_capacity() const { return static_cast<std::size_t>(5 * m_compression); }
+
+    void push(double x, double weight)
+    {
+        if (std::isnan(x))
+        {
+            return;
+        }
+        m_buffer.push_back(centroid{x, weight});
+        m_count += weight;
+        m_min = std::min(m_min, x);
+        m_max = std::max(m_max, x);
+        if (m_buffer.size() >= buffer_capacity())
+        {
+            compress();
+        }
+    }
+
+    // scale function k1: k(q) = compression / (2 pi) * asin(2q - 1), a centroid spans at most 1 in k
+    double q_limit(double q) const
+    {
+        constexpr double pi = 3.14159265358979323846;
+        double k = m_compression / (2 * pi) * std::asin(2 * q - 1) + 1;
+        if (k >= m_compression / 4)
+        {
+            return 1;
+        }
+        return (std::sin(k * 2 * pi / m_compression) + 1) / 2;
+    }
+
+    // merge the buffer into the centroids, logically const so that `quantile` can be called on a const sketch
+    void compress() const
+    {
+        if (m_buffer.empty())
+        {
+            return;
+        }
+        m_buffer.insert(m_buffer.end(), m_centroids.begin(), m_centroids.end());
+        std::sort(m_buffer.begin(), m_buffer.end(),
+                  [](const centroid &a, const centroid &b) { return a.mean < b.mean; });
+        m_centroids.clear();
+        centroid cur = m_buffer.front();
+        double before = 0;
+        double limit = q_limit(0) * m_count;
+        for (std::size_t i = 1; i < m_buffer.size(); ++i)
+        {
+            const auto &next = m_buffer[i];
+            if (before + cur.weight + next.weight <= limit)
+            {
+                cur.weight += next.weight;
+                cur.mean += (next.mean - cur.mean) * next.weight / cur.weight;
+            }
+            else
+            {
+                before += cur.weight;
+                m_centroids.push_back(cur);
+                limit = q_limit(before / m_count) * m_count;
+                cur = next;
+            }
+        }
+        m_centroids.push_back(cur);
+        m_buffer.clear();
+    }
+
+    double m_compression;
+    double m_count = 0;
+    double m_min = std::numeric_limits<double>::infinity();
+    double m_max = -std::numeric_limits<double>::infinity();
+    mutable std::vector<centroid> m_centroids;
+    mutable std::vector<centroid> m_buffer;
+};
+
 } // namespace util
 
 #endif // UTIL_STATISTICS_HPP
\ No newline at end of file
@@ -1,8 +1,29 @@
+#include "autocorrelation.hpp"
+#include "covariance.hpp"
+#include "histogram.hpp"
+#include "resample.hpp"
+#include "rolling.hpp"
 #include "statistics.hpp"
 #include <iostream>
 
 using namespace util;
 
+// a minimal row-major matrix with the interface `covariance(data)` needs, like `util::Matrix<T>`
+template <typename T>
+class table
+{
+  public:
+    table(std::size_t rows, std::size_t cols, T value) : m_cols(cols), m_data(rows * cols, value) {}
+    std::size_t rows() const { return m_data.size() / m_cols; }
+    std::size_t cols() const { return m_cols; }
+    T &operator()(std::size_t i, std::size_t j) { return m_data[i * m_cols + j]; }
+    const T &operator()(std::size_t i, std::size_t j) const { return m_data[i * m_cols + j]; }
+
+  private:
+    std::size_t m_cols;
+    std::vector<T> m_data;
+};
+
 int main(int argc, char const *argv[])
 {
     std::vector<int> x(100, 0);
@@ -13,5 +34,125 @@ int main(int argc, char const *argv[])
     std::cout << "sample variance = " << variance(x, 1) << "\n";
 
     std::cout << draft(x.cbegin(), x.cend(), 1);
+
+    // float sum with ten million 0.1f
+    std::vector<float> y(10000000, 0.1f);
+    std::cout << "naive sum = " << sum(y) << ", pairwise sum = " << sum(y, summation_policy::pairwise)
+              << ", kahan sum = " << sum(y, summation_policy::kahan) << "\n";
+
+    // accumulate two halves separately, then merge
+    statistics_accumulator lower, upper;
+    lower.push(x.cbegin(), x.cbegin() + 50);
+    upper.push(std::vector<int>(x.cbegin() + 50, x.cend()));
+    lower.merge(upper);
+    std::cout << "accumulator: count = " << lower.count() << ", min = " << lower.min() << ", max = " << lower.max()
+              << "\n";
+    std::cout << lower.draft(1);
+
+    // exact quantiles and the streaming estimate
+    quantile_sketch sketch;
+    sketch.push(x);
+    auto q = quantile(x, {0.5, 0.9, 0.99});
+    std::cout << "median = " << median(x) << ", p90 = " << q[1] << ", p99 = " << q[2]
+              << ", sketch p99 = " << sketch.quantile(0.99) << "\n";
+    // invalid q (NaN or out of [0, 1]) give NaN without affecting the others
+    auto mixed = quantile(x, {0.9, std::numeric_limits<double>::quiet_NaN(), 1.5, 0.5});
+    std::cout << "p90 = " << mixed[0] << ", q = NaN: " << mixed[1] << ", q = 1.5: " << mixed[2]
+              << ", median = " << mixed[3] << "\n";
+
+    // ten bins of width 10, and bins with variable width
+    histogram fixed(0., 100., 10), variable(std::vector<double>{1, 2, 5, 10, 20, 50, 100});
+    fixed.push(x);
+    variable.push(x);
+    std::cout << "histogram:";
+    for (std::size_t i = 0; i < fixed.bins(); ++i)
+        std::cout << " " << fixed[i];
+    std::cout << ", overflow = " << fixed.overflow() << "\nvariable histogram:";
+    for (std::size_t i = 0; i < variable.bins(); ++i)
+        std::cout << " [" << variable.lower(i) << ", " << variable.upper(i) << "): " << variable[i];
+    std::cout << ", overflow = " << variable.overflow() << "\n";
+
+    // error of the mean and of 1 / mean
+    auto boot = bootstrap(x, [](const std::vector<int> &v) { return mean(v); }, 200, 1);
+    std::cout << "bootstrap mean:\n" << boot;
+    std::cout << "jackknife 1 / mean:\n" << jackknife(x, [](double m) { return 1 / m; }, 10);
+
+    // a correlated series: x_{i+1} = 0.9 x_i + noise, tau = 1.9 / 0.1 = 19
+    Random<std::mt19937_64> rng(2);
+    std::vector<double> chain(100000);
+    double state = 0;
+    for (auto &c : chain)
+        c = state = 0.9 * state + rng.randreal(-1, 1);
+    std::cout << integrated_autocorrelation_time(chain);
+    for (auto &level : blocking(chain))
+        std::cout << "block size " << level.block_size << ": error = " << level.error << " +- "
+                  << level.error_of_error << "\n";
+
+    // covariance of (i, i^2, 100 - i) over the samples i = 1, ..., 100
+    covariance_accumulator cov(3);
+    for (auto i : x)
+        cov.push({double(i), double(i * i), double(100 - i)});
+    std::cout << "cov(i, i) = " << cov.covariance(0, 0, 1) << ", cov(i, i^2) = " << cov.covariance(0, 1, 1)
+              << ", corr(i, i^2) = " << cov.correlation(0, 1) << ", corr(i, 100 - i) = " << cov.correlation(0, 2)
+              << "\n";
+
+    // covariance and correlation matrices of 1000 samples of 5 variables with large offsets,
+    // compared with the direct two-pass formula, errors are relative to sqrt(cov(a, a) cov(b, b))
+    table<double> samples(1000, 5, 0.);
+    for (std::size_t i = 0; i < samples.rows(); ++i)
+    {
+        double u = rng.randreal(-1, 1), v = rng.randreal(-1, 1);
+        samples(i, 0) = 1e6 + u;
+        samples(i, 1) = 2 * u + v;
+        samples(i, 2) = -u + 1e-3 * rng.randreal(-1, 1);
+        samples(i, 3) = v * v;
+        samples(i, 4) = rng.randreal(0, 10);
+    }
+    auto cov_matrix = covariance(samples, 1);
+    auto corr_matrix = correlation(samples);
+    std::size_t n = samples.rows(), p = samples.cols();
+    std::vector<double> means(p, 0.);
+    for (std::size_t j = 0; j < p; ++j)
+    {
+        for (std::size_t i = 0; i < n; ++i)
+            means[j] += samples(i, j);
+        means[j] /= n;
+    }
+    table<double> direct(p, p, 0.);
+    for (std::size_t a = 0; a < p; ++a)
+    {
+        for (std::size_t b = 0; b < p; ++b)
+        {
+            for (std::size_t i = 0; i < n; ++i)
+                direct(a, b) += (samples(i, a) - means[a]) * (samples(i, b) - means[b]);
+            direct(a, b) /= n - 1;
+        }
+    }
+    double cov_error = 0, corr_error = 0;
+    for (std::size_t a = 0; a < p; ++a)
+    {
+        for (std::size_t b = 0; b < p; ++b)
+        {
+            double scale = std::sqrt(direct(a, a) * direct(b, b));
+            cov_error = std::max(cov_error, std::abs(cov_matrix(a, b) - direct(a, b)) / scale);
+            double corr = direct(a, b) / scale;
+            corr_error = std::max(corr_error, std::abs(corr_matrix(a, b) - corr));
+        }
+    }
+    std::cout << "covariance matrix: max scaled error = " << cov_error
+              << ", correlation matrix: max error = " << corr_error << "\n";
+
+    // statistics of the last 10 data, and of the data in the last 10 time units with i as time
+    rolling_statistics last(10);
+    rolling_time_statistics<> recent(10.);
+    for (auto i : x)
+    {
+        last.push(i);
+        recent.push(i * 0.5, i);
+    }
+    std::cout << "last 10: mean = " << last.mean() << ", variance = " << last.variance() << ", min = " << last.min()
+              << ", max = " << last.max() << "\n";
+    std::cout << "last 10 time: count = " << recent.count() << ", mean = " << recent.mean()
+              << ", min = " << recent.min() << "\n";
     return 0;
 }